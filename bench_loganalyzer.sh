@@ -0,0 +1,149 @@
+#!/bin/bash
+#
+# Throughput benchmark for loganalyzer.
+#
+# Usage: ./bench_loganalyzer.sh [--check] [--update-baseline] [size...]
+#
+#   size               input sizes to test (default: 1M 16M 256M; up to 20G)
+#   --check            compare warm-cache throughput against bench_baseline.txt
+#                      and exit 1 if any mode is more than THRESHOLD% slower
+#   --update-baseline  rewrite bench_baseline.txt from this run
+#
+# Environment:
+#   BENCH_DIR   where generated logs are kept (default /tmp/loganalyzer_bench)
+#   THRESHOLD   allowed slowdown in percent for --check (default 15)
+#   REPEAT      warm-cache runs per mode; the fastest is reported (default 5)
+#
+# Build first:
+#   gcc -O2 -pthread loganalyzer.c mappedfile.c -o loganalyzer
+#   gcc -O2 logbench.c -o logbench -lm
+
+BENCH_DIR=${BENCH_DIR:-/tmp/loganalyzer_bench}
+THRESHOLD=${THRESHOLD:-15}
+REPEAT=${REPEAT:-5}
+BASELINE=bench_baseline.txt
+OUTPUT=bench_output.txt
+
+check=0
+update=0
+sizes=()
+for arg in "$@"; do
+    case "$arg" in
+        --check) check=1 ;;
+        --update-baseline) update=1 ;;
+        -h|--help) sed -n '3,20p' "$0" | sed 's/^# \{0,1\}//'; exit 0 ;;
+        *) sizes+=("$arg") ;;
+    esac
+done
+[ ${#sizes[@]} -eq 0 ] && sizes=(1M 16M 256M)
+
+for bin in ./loganalyzer ./logbench; do
+    if [ ! -x "$bin" ]; then
+        echo "Error: $bin not found; see the build commands at the top of $0" >&2
+        exit 2
+    fi
+done
+mkdir -p "$BENCH_DIR" || exit 2
+
+# mode name and loganalyzer arguments; the log path is appended
+modes=(
+    "count|-s"
+    "count-1thread|-s -j 1"
+    "templates|-t 10"
+    "histogram|-H 60"
+    "index-build|--build-index"
+    "index-query|--count --lines 1000:2000 --nth ERROR:100"
+)
+
+# print "elapsed maxrss_kb cycles source" for one measured run; loganalyzer's
+# own "Scanned ..." line on stderr is dropped, a failure still shows in status=
+measure() {
+    ./logbench run ./loganalyzer "$@" 2> /dev/null | awk '{
+        for (i = 1; i <= NF; i++) { split($i, kv, "="); v[kv[1]] = kv[2] }
+        if (v["status"] != 0) exit 1
+        print v["elapsed"], v["maxrss_kb"], v["cycles"], v["cycles_src"]
+    }'
+}
+
+# fastest of $1 measured runs
+measure_best() {
+    local runs=$1 best="" r i
+    shift
+    for ((i = 0; i < runs; i++)); do
+        r=$(measure "$@") || return 1
+        if [ -z "$best" ] || awk -v a="${r%% *}" -v b="${best%% *}" 'BEGIN { exit !(a < b) }'; then
+            best=$r
+        fi
+    done
+    echo "$best"
+}
+
+echo "=== loganalyzer benchmark ($(nproc) CPUs) ==="
+printf "%-14s %7s %5s %10s %12s %10s\n" mode size cache "MB/s" "cycles/B" "RSS(KB)" | tee "$OUTPUT"
+
+for size in "${sizes[@]}"; do
+    log="$BENCH_DIR/bench_$size.log"
+    if [ ! -f "$log" ]; then
+        echo "[generating $size log]" >&2
+        ./logbench gen -o "$log" -s "$size" -d skewed || exit 2
+    fi
+    bytes=$(stat -c %s "$log")
+    ./loganalyzer --build-index "$log" > /dev/null
+
+    for entry in "${modes[@]}"; do
+        name=${entry%%|*}
+        read -r -a args <<< "${entry#*|}"
+
+        for cache in cold warm; do
+            runs=$REPEAT
+            if [ "$cache" = cold ]; then
+                ./logbench evict "$log" "$log.idx" 2> /dev/null
+                runs=1
+            else
+                ./loganalyzer "${args[@]}" "$log" > /dev/null 2>&1
+            fi
+
+            if ! result=$(measure_best $runs "${args[@]}" "$log"); then
+                echo "Error: loganalyzer ${args[*]} $log failed" >&2
+                exit 2
+            fi
+            read -r elapsed rss cycles src <<< "$result"
+            awk -v n="$name" -v s="$size" -v c="$cache" -v b="$bytes" -v t="$elapsed" \
+                -v r="$rss" -v cy="$cycles" -v src="$src" 'BEGIN {
+                mbs = t > 0 ? b / 1e6 / t : 0
+                printf "%-14s %7s %5s %10.1f %12.2f%s %10d\n", n, s, c, mbs, cy / b,
+                       src == "est" ? "~" : " ", r
+            }' | tee -a "$OUTPUT"
+        done
+    done
+done
+echo "(~ marks cycles estimated from CPU time x clock rate when perf counters are unavailable)"
+
+# the baseline holds warm-cache throughput only; cold numbers depend on the disk
+if [ $update -eq 1 ]; then
+    {
+        echo "# mode size MB/s (warm cache), written by bench_loganalyzer.sh --update-baseline"
+        echo "# machine-specific: regenerate on the machine that runs --check"
+        awk 'NR > 1 && $3 == "warm" { print $1, $2, $4 }' "$OUTPUT"
+    } > "$BASELINE"
+    echo "Baseline written to $BASELINE"
+fi
+
+if [ $check -eq 1 ]; then
+    if [ ! -f "$BASELINE" ]; then
+        echo "Error: no $BASELINE; run with --update-baseline first" >&2
+        exit 2
+    fi
+    echo -e "\n=== Checking against $BASELINE (threshold ${THRESHOLD}%) ==="
+    awk -v th="$THRESHOLD" '
+        FNR == NR { if ($1 !~ /^#/) base[$1 " " $2] = $3; next }
+        FNR > 1 && $3 == "warm" && (($1 " " $2) in base) {
+            limit = base[$1 " " $2] * (100 - th) / 100
+            status = $4 < limit ? "SLOWER" : "ok"
+            if ($4 < limit) failed = 1
+            printf "%-14s %7s %10.1f MB/s (baseline %.1f) %s\n", $1, $2, $4, base[$1 " " $2], status
+        }
+        END { exit failed }
+    ' "$BASELINE" "$OUTPUT" || { echo "FAIL: throughput regression"; exit 1; }
+    echo "PASS"
+fi
@@ -1,16 +1,18 @@
 #include <iostream>
 #include <string>
 #include <cstring>
+#include <vector>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <getopt.h>
 #include <signal.h>
 #include <termios.h>
+#include "mappedfile.h"
 
 using namespace std;
 
-#define BUFFER_SIZE 4096
+#define BUFFER_SIZE (1024 * 1024)
 
 volatile sig_atomic_t interrupted = 0; // signal handling
 
@@ -70,13 +72,14 @@ string read_password() {
 void print_usage(const char* program) {
     cout << "\nUsage: " << program << " [OPTIONS]\n\n";
     cout << "Required:\n";
-    cout << "  -i <file>       Input file\n";
+    cout << "  -i <file>       Input file (- for stdin, needs -p)\n";
     cout << "  -o <file>       Output file\n\n";
     cout << "Mode:\n";
     cout << "  -e              Encrypt (default)\n";
     cout << "  -d              Decrypt\n\n";
     cout << "Optional:\n";
     cout << "  -p <password>   Password (will prompt if not given)\n";
+    cout << "  -v              Print I/O counters (bytes mapped, read calls, page faults)\n";
     cout << "  -h              Show help\n\n";
     cout << "Examples:\n";
     cout << "  " << program << " -e -i plain.txt -o encrypted.bin\n";
@@ -90,91 +93,85 @@ int xor_crypt(const char* input, const char* output, const string& key) {
         return 1;
     }
 
-    // Open input file
-    int in_fd = open(input, O_RDONLY);
-    if (in_fd < 0) {
+    // Open input file: regular files are mapped in windows, pipes are read in large blocks
+    struct mapped_file in;
+    if (mf_open(&in, input, MF_SEQUENTIAL) == -1) {
         perror("Error opening input file");
         return 1;
     }
 
-    // Get file size
-    struct stat st;
-    if (fstat(in_fd, &st) < 0) {
-        perror("Error getting file info");
-        close(in_fd);
-        return 1;
-    }
-
     // Create output file
     int out_fd = open(output, O_WRONLY | O_CREAT | O_TRUNC, 0600);
     if (out_fd < 0) {
         perror("Error creating output file");
-        close(in_fd);
+        mf_close(&in);
         return 1;
     }
 
-    // Process file
-    unsigned char buffer[BUFFER_SIZE];
+    // Process file; the mapping is read-only, so XOR into a buffer for write()
+    vector<unsigned char> buffer(BUFFER_SIZE);
+    const char* data;
     ssize_t bytes_read;
     size_t key_index = 0;
-
-    while ((bytes_read = read(in_fd, buffer, BUFFER_SIZE)) > 0) {
-        // Check for interrupt
-        if (interrupted) {
-            cout << "\nInterrupted! Cleaning up..." << endl;
-            secure_wipe(buffer, BUFFER_SIZE);
-            close(in_fd);
-            close(out_fd);
-            unlink(output);
-            return 1;
-        }
-
-        // XOR each byte
-        for (ssize_t i = 0; i < bytes_read; i++) {
-            buffer[i] ^= key[key_index % key.length()];
-            key_index++;
-        }
-
-        // Write output
-        if (write(out_fd, buffer, bytes_read) != bytes_read) {
-            perror("Error writing output");
-            secure_wipe(buffer, BUFFER_SIZE);
-            close(in_fd);
-            close(out_fd);
-            unlink(output);
-            return 1;
+    size_t key_len = key.length();
+    int result = 0;
+
+    while (!result && (bytes_read = mf_next(&in, &data)) > 0) {
+        for (ssize_t done = 0; done < bytes_read; ) {
+            // Check for interrupt
+            if (interrupted) {
+                cout << "\nInterrupted! Cleaning up..." << endl;
+                result = 1;
+                break;
+            }
+
+            // XOR each byte
+            size_t n = (size_t)(bytes_read - done) < buffer.size() ? (size_t)(bytes_read - done)
+                                                                     : buffer.size();
+            for (size_t i = 0; i < n; i++) {
+                buffer[i] = (unsigned char)data[done + i] ^ (unsigned char)key[key_index];
+                if (++key_index == key_len)
+                    key_index = 0;
+            }
+
+            // Write output
+            if (write(out_fd, buffer.data(), n) != (ssize_t)n) {
+                perror("Error writing output");
+                result = 1;
+                break;
+            }
+            done += (ssize_t)n;
         }
     }
 
     // Check for read errors
-    if (bytes_read < 0) {
+    if (!result && bytes_read < 0) {
         perror("Error reading input");
-        secure_wipe(buffer, BUFFER_SIZE);
-        close(in_fd);
-        close(out_fd);
-        unlink(output);
-        return 1;
+        result = 1;
     }
 
-    // Cleanup
-    secure_wipe(buffer, BUFFER_SIZE);
-    close(in_fd);
+    // Cleanup; partial output is removed
+    secure_wipe(buffer.data(), buffer.size());
+    mf_close(&in);
     close(out_fd);
+    if (result)
+        unlink(output);
 
-    return 0;
+    return result;
 }
 
 int main(int argc, char* argv[]) {
     signal(SIGINT, handle_signal);
 
     bool encrypt_mode = true;
+    bool io_stats = false;
     string input_file;
     string output_file;
     string password;
 
     // Parse options
     int opt;
-    while ((opt = getopt(argc, argv, "edi:o:p:h")) != -1) {
+    while ((opt = getopt(argc, argv, "edi:o:p:hv")) != -1) {
         switch (opt) {
             case 'e':
                 encrypt_mode = true;
@@ -191,6 +188,9 @@ int main(int argc, char* argv[]) {
             case 'p':
                 password = optarg;
                 break;
+            case 'v':
+                io_stats = true;
+                break;
             case 'h':
                 print_usage(argv[0]);
                 return 0;
@@ -211,6 +211,12 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
+    // the password prompt reads stdin too
+    if (input_file == "-" && password.empty()) {
+        cerr << "Error: -i - needs the password given with -p" << endl;
+        return 1;
+    }
+
     if (password.empty()) {
         password = read_password();
         if (password.empty()) {
@@ -230,6 +236,8 @@ int main(int argc, char* argv[]) {
     } else {
         cerr << "Failed!" << endl;
     }
+    if (io_stats)
+        mf_print_stats(stdout);
 
     return result;
 }
\ No newline at end of file
@@ -1,23 +1,1628 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
-#include <fcntl.h>
+#include <stdint.h>
 #include <unistd.h>
-#include <sys/mman.h>
 #include <sys/stat.h>
 #include <string.h>
 #include <errno.h>
+#include <time.h>
+#include <getopt.h>
+#include <glob.h>
+#include <ftw.h>
+#include <pthread.h>
+
+#include "mappedfile.h"
+
+#define DEFAULT_TS_FORMAT "%Y-%m-%d %H:%M:%S"
+#define MAX_TEMPLATE_LEN  256
+#define ARENA_BLOCK_SIZE  (64 * 1024)
+
+// line severity, used by the histogram and template modes
+enum level { LVL_ERROR, LVL_WARNING, LVL_INFO, LVL_OTHER, LVL_COUNT };
+
+static const char *level_names[LVL_COUNT] = { "ERROR", "WARNING", "INFO", "OTHER" };
+static const size_t level_lens[LVL_COUNT] = { 5, 7, 4, 5 };
+
+// bump allocator for interned template strings, so we never malloc per line
+struct arena_block {
+    struct arena_block *next;
+    size_t used;
+    size_t cap;
+    char data[];
+};
+
+struct arena {
+    struct arena_block *head;
+};
+
+static void *arena_alloc(struct arena *a, size_t n) {
+    struct arena_block *b = a->head;
+    if (!b || b->used + n > b->cap) {
+        size_t cap = n > ARENA_BLOCK_SIZE ? n : ARENA_BLOCK_SIZE;
+        b = malloc(sizeof(*b) + cap);
+        if (!b)
+            return NULL;
+        b->used = 0;
+        b->cap = cap;
+        b->next = a->head;
+        a->head = b;
+    }
+    void *p = b->data + b->used;
+    b->used += n;
+    return p;
+}
+
+static void arena_free(struct arena *a) {
+    while (a->head) {
+        struct arena_block *next = a->head->next;
+        free(a->head);
+        a->head = next;
+    }
+}
+
+// open-addressing hash table keyed by (level, template); strings live in the arena
+struct tmpl_entry {
+    uint64_t hash;
+    const char *str;    // NULL marks an empty slot
+    uint32_t len;
+    uint8_t level;
+    uint64_t count;
+};
+
+struct tmpl_table {
+    struct tmpl_entry *slots;
+    size_t cap;         // always a power of two
+    size_t used;
+    struct arena strings;
+};
+
+static uint64_t fnv1a(const char *s, size_t len, uint64_t h) {
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static int table_init(struct tmpl_table *t, size_t cap) {
+    t->slots = calloc(cap, sizeof(*t->slots));
+    if (!t->slots)
+        return -1;
+    t->cap = cap;
+    t->used = 0;
+    t->strings.head = NULL;
+    return 0;
+}
+
+static int table_grow(struct tmpl_table *t) {
+    size_t new_cap = t->cap * 2;
+    struct tmpl_entry *slots = calloc(new_cap, sizeof(*slots));
+    if (!slots)
+        return -1;
+
+    for (size_t i = 0; i < t->cap; i++) {
+        if (!t->slots[i].str)
+            continue;
+        size_t j = t->slots[i].hash & (new_cap - 1);
+        while (slots[j].str)
+            j = (j + 1) & (new_cap - 1);
+        slots[j] = t->slots[i];
+    }
+
+    free(t->slots);
+    t->slots = slots;
+    t->cap = new_cap;
+    return 0;
+}
+
+static int table_add(struct tmpl_table *t, int level, const char *s, size_t len) {
+    if ((t->used + 1) * 10 > t->cap * 7 && table_grow(t) == -1)
+        return -1;
+
+    uint64_t h = fnv1a(s, len, 14695981039346656037ULL ^ (uint64_t)level);
+    size_t i = h & (t->cap - 1);
+
+    while (t->slots[i].str) {
+        struct tmpl_entry *e = &t->slots[i];
+        if (e->hash == h && e->level == level && e->len == len &&
+            memcmp(e->str, s, len) == 0) {
+            e->count++;
+            return 0;
+        }
+        i = (i + 1) & (t->cap - 1);
+    }
+
+    char *copy = arena_alloc(&t->strings, len + 1);
+    if (!copy)
+        return -1;
+    memcpy(copy, s, len);
+    copy[len] = '\0';
+
+    t->slots[i].hash = h;
+    t->slots[i].str = copy;
+    t->slots[i].len = (uint32_t)len;
+    t->slots[i].level = (uint8_t)level;
+    t->slots[i].count = 1;
+    t->used++;
+    return 0;
+}
+
+static void table_free(struct tmpl_table *t) {
+    free(t->slots);
+    arena_free(&t->strings);
+}
+
+// per-interval level counts in an open-addressing table keyed by bucket
+// number, so one line with an absurd timestamp costs one slot rather than
+// every bucket between it and the rest of the log
+#define HIST_MAX_GAP 100000     // longer runs of empty buckets are not printed
+
+struct bucket {
+    long num;           // timestamp / interval
+    int used;
+    long counts[LVL_COUNT];
+};
+
+struct histogram {
+    long interval;      // seconds per bucket
+    size_t len;         // buckets in use
+    size_t cap;         // always a power of two
+    struct bucket *buckets;
+    struct bucket *last;        // most recently hit bucket; logs are mostly in order
+    long untimed[LVL_COUNT];    // lines whose prefix did not parse
+};
+
+// runs of 16 consecutive buckets share one hashed position, so an in-order
+// log fills neighbouring slots instead of a random one per new bucket
+static size_t bucket_slot(long num, size_t cap) {
+    uint64_t h = ((uint64_t)num >> 4) * 11400714819323198485ULL;
+    return (size_t)((h >> 28) + ((uint64_t)num & 15)) & (cap - 1);
+}
+
+static int histogram_grow(struct histogram *hg) {
+    size_t cap = hg->cap ? hg->cap * 2 : 256;
+    struct bucket *nb = calloc(cap, sizeof(*nb));
+    if (!nb)
+        return -1;
+
+    for (size_t i = 0; i < hg->cap; i++) {
+        if (!hg->buckets[i].used)
+            continue;
+        size_t j = bucket_slot(hg->buckets[i].num, cap);
+        while (nb[j].used)
+            j = (j + 1) & (cap - 1);
+        nb[j] = hg->buckets[i];
+    }
+
+    free(hg->buckets);
+    hg->buckets = nb;
+    hg->cap = cap;
+    hg->last = NULL;
+    return 0;
+}
+
+static int histogram_add(struct histogram *hg, time_t ts, int level) {
+    long b = (long)(ts / hg->interval);
+    if (ts % hg->interval < 0)
+        b--;                // round pre-1970 timestamps down, not toward zero
+    if (hg->last && hg->last->num == b) {
+        hg->last->counts[level]++;
+        return 0;
+    }
+
+    if ((hg->len + 1) * 10 > hg->cap * 7 && histogram_grow(hg) == -1)
+        return -1;
+
+    size_t i = bucket_slot(b, hg->cap);
+    while (hg->buckets[i].used && hg->buckets[i].num != b)
+        i = (i + 1) & (hg->cap - 1);
+
+    struct bucket *bk = &hg->buckets[i];
+    if (!bk->used) {
+        bk->used = 1;
+        bk->num = b;
+        hg->len++;
+    }
+    bk->counts[level]++;
+    hg->last = bk;
+    return 0;
+}
+
+// settings for the histogram / template mode
+struct analysis {
+    const char *ts_format;
+    int top_n;          // 0 = templates disabled
+    int csv;
+    struct histogram hist;  // interval 0 = histogram disabled
+    struct tmpl_table templates;
+};
+
+// parse the timestamp prefix of [line, end); returns where the message starts or NULL
+static const char *parse_timestamp(const char *line, const char *end,
+                                   const char *fmt, time_t *out) {
+    char buf[64];
+    size_t n = (size_t)(end - line);
+    if (n >= sizeof(buf))
+        n = sizeof(buf) - 1;
+    memcpy(buf, line, n);
+    buf[n] = '\0';
+
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    char *rest = strptime(buf, fmt, &tm);
+    if (!rest)
+        return NULL;
+
+    *out = timegm(&tm);
+    return line + (rest - buf);
+}
+
+// work out the level of a line; *msg is advanced past a leading level keyword
+static int classify_line(const char **msg, const char *end) {
+    const char *p = *msg;
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '['))
+        p++;
+
+    for (int l = 0; l < LVL_OTHER; l++) {
+        size_t len = level_lens[l];
+        if ((size_t)(end - p) >= len && memcmp(p, level_names[l], len) == 0) {
+            p += len;
+            while (p < end && (*p == ']' || *p == ':' || *p == ' ' || *p == '\t'))
+                p++;
+            *msg = p;
+            return l;
+        }
+    }
+
+    // no leading keyword: fall back to any keyword in the line, most severe first
+    for (int l = 0; l < LVL_OTHER; l++) {
+        if (memmem(*msg, (size_t)(end - *msg), level_names[l], level_lens[l]))
+            return l;
+    }
+    return LVL_OTHER;
+}
+
+static int is_hex(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+static int is_word(char c) {
+    return is_hex(c) || (c >= 'g' && c <= 'z') || (c >= 'G' && c <= 'Z') || c == '_';
+}
+
+// mask numbers, hex and paths in [p, end) so similar messages share a template
+static size_t normalize_message(const char *p, const char *end, char *out, size_t cap) {
+    size_t n = 0;
+
+#define EMIT(s) do { \
+        const char *e_ = (s); \
+        while (*e_ && n < cap) out[n++] = *e_++; \
+    } while (0)
+
+    while (p < end && n < cap) {
+        char c = *p;
+        int at_start = (n == 0 || out[n - 1] == ' ' || !is_word(out[n - 1]));
+
+        // paths: /x/y, ./x, ~/x up to the next whitespace
+        if (at_start && (c == '/' || ((c == '.' || c == '~') && p + 1 < end && p[1] == '/'))) {
+            while (p < end && *p != ' ' && *p != '\t')
+                p++;
+            EMIT("<PATH>");
+            continue;
+        }
+
+        // 0x-prefixed hex
+        if (c == '0' && p + 2 < end && (p[1] == 'x' || p[1] == 'X') && is_hex(p[2])) {
+            p += 2;
+            while (p < end && is_hex(*p))
+                p++;
+            EMIT("<HEX>");
+            continue;
+        }
+
+        // bare hex runs (ids, hashes): at least 8 hex chars with a letter and a digit
+        if (at_start && is_hex(c)) {
+            const char *q = p;
+            int digits = 0, letters = 0;
+            while (q < end && is_hex(*q)) {
+                if (*q <= '9') digits++; else letters++;
+                q++;
+            }
+            if (q - p >= 8 && digits && letters && (q == end || !is_word(*q))) {
+                p = q;
+                EMIT("<HEX>");
+                continue;
+            }
+        }
+
+        // decimal numbers, including 1.5 and 10.0.0.1
+        if (c >= '0' && c <= '9') {
+            while (p < end && ((*p >= '0' && *p <= '9') ||
+                               (*p == '.' && p + 1 < end && p[1] >= '0' && p[1] <= '9')))
+                p++;
+            EMIT("<N>");
+            continue;
+        }
+
+        // collapse runs of whitespace
+        if (c == ' ' || c == '\t' || c == '\r') {
+            while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+                p++;
+            if (n > 0 && p < end)
+                out[n++] = ' ';
+            continue;
+        }
+
+        out[n++] = c;
+        p++;
+    }
+
+#undef EMIT
+    return n;
+}
+
+// feed one line (without its newline) into the histogram and template table
+static int analyze_line(struct analysis *an, const char *line, const char *end) {
+    time_t ts;
+    const char *msg = parse_timestamp(line, end, an->ts_format, &ts);
+    int timed = msg != NULL;
+    if (!timed)
+        msg = line;
+
+    int level = classify_line(&msg, end);
+
+    if (an->hist.interval > 0) {
+        if (!timed)
+            an->hist.untimed[level]++;
+        else if (histogram_add(&an->hist, ts, level) == -1)
+            return -1;
+    }
+
+    if (an->top_n > 0) {
+        char tmpl[MAX_TEMPLATE_LEN];
+        size_t len = normalize_message(msg, end, tmpl, sizeof(tmpl));
+        if (table_add(&an->templates, level, tmpl, len) == -1)
+            return -1;
+    }
+    return 0;
+}
+
+static int analyze_buffer(struct analysis *an, struct mapped_file *mf, const char *map, size_t size) {
+    const char *p = map, *end = map + size;
+    while (p < end) {
+        mf_prefetch(mf, (uint64_t)(p - map));
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        const char *line_end = nl ? nl : end;
+        if (analyze_line(an, p, line_end) == -1)
+            return -1;
+        p = nl ? nl + 1 : end;
+    }
+    return 0;
+}
+
+static int cmp_entry_count(const void *a, const void *b) {
+    const struct tmpl_entry *x = *(const struct tmpl_entry *const *)a;
+    const struct tmpl_entry *y = *(const struct tmpl_entry *const *)b;
+    if (x->count != y->count)
+        return x->count < y->count ? 1 : -1;
+    return strcmp(x->str, y->str);
+}
+
+static void print_csv_field(const char *s) {
+    putchar('"');
+    for (; *s; s++) {
+        if (*s == '"')
+            putchar('"');
+        putchar(*s);
+    }
+    putchar('"');
+}
+
+static void print_templates(struct analysis *an) {
+    struct tmpl_table *t = &an->templates;
+    struct tmpl_entry **sorted = malloc((t->used ? t->used : 1) * sizeof(*sorted));
+    if (!sorted) {
+        perror("Error allocating template list");
+        return;
+    }
+
+    size_t n = 0;
+    for (size_t i = 0; i < t->cap; i++)
+        if (t->slots[i].str)
+            sorted[n++] = &t->slots[i];
+    qsort(sorted, n, sizeof(*sorted), cmp_entry_count);
+
+    size_t shown = n < (size_t)an->top_n ? n : (size_t)an->top_n;
+    if (an->csv) {
+        printf("count,level,template\n");
+        for (size_t i = 0; i < shown; i++) {
+            printf("%llu,%s,", (unsigned long long)sorted[i]->count,
+                   level_names[sorted[i]->level]);
+            print_csv_field(sorted[i]->str);
+            putchar('\n');
+        }
+    } else {
+        printf("Top %zu of %zu message templates:\n", shown, n);
+        for (size_t i = 0; i < shown; i++)
+            printf("%8llu  %-7s  %s\n", (unsigned long long)sorted[i]->count,
+                   level_names[sorted[i]->level], sorted[i]->str);
+    }
+
+    free(sorted);
+}
+
+static int bucket_cmp(const void *a, const void *b) {
+    long x = ((const struct bucket *)a)->num, y = ((const struct bucket *)b)->num;
+    return (x > y) - (x < y);
+}
+
+static void print_bucket_row(struct analysis *an, long num, const long *c) {
+    char when[32];
+    time_t start = (time_t)(num * an->hist.interval);
+    struct tm tm;
+    if (!gmtime_r(&start, &tm) || !strftime(when, sizeof(when), "%Y-%m-%dT%H:%M:%SZ", &tm))
+        snprintf(when, sizeof(when), "@%lld", (long long)start);
+
+    if (an->csv)
+        printf("%s,%ld,%ld,%ld,%ld\n", when, c[LVL_ERROR], c[LVL_WARNING],
+               c[LVL_INFO], c[LVL_OTHER]);
+    else
+        printf("%s  ERROR=%-6ld WARNING=%-6ld INFO=%-6ld OTHER=%ld\n", when,
+               c[LVL_ERROR], c[LVL_WARNING], c[LVL_INFO], c[LVL_OTHER]);
+}
+
+static void print_histogram(struct analysis *an) {
+    struct histogram *hg = &an->hist;
+    static const long zero[LVL_COUNT];
+
+    if (an->csv)
+        printf("bucket_start,error,warning,info,other\n");
+    else
+        printf("Level histogram (%lds buckets):\n", hg->interval);
+
+    // compact the used slots (the table is not used after this) and print
+    // them in time order; short runs of empty buckets are filled in, longer
+    // ones are skipped
+    size_t n = 0;
+    for (size_t i = 0; i < hg->cap; i++)
+        if (hg->buckets[i].used)
+            hg->buckets[n++] = hg->buckets[i];
+    hg->last = NULL;
+    qsort(hg->buckets, n, sizeof(*hg->buckets), bucket_cmp);
+
+    for (size_t i = 0; i < n; i++) {
+        if (i > 0) {
+            long prev = hg->buckets[i - 1].num, gap = hg->buckets[i].num - prev - 1;
+            if (gap > HIST_MAX_GAP) {
+                if (!an->csv)
+                    printf("... %ld empty buckets skipped ...\n", gap);
+            } else {
+                for (long k = 1; k <= gap; k++)
+                    print_bucket_row(an, prev + k, zero);
+            }
+        }
+        print_bucket_row(an, hg->buckets[i].num, hg->buckets[i].counts);
+    }
+
+    long *u = hg->untimed;
+    if (u[LVL_ERROR] || u[LVL_WARNING] || u[LVL_INFO] || u[LVL_OTHER]) {
+        if (an->csv)
+            printf("untimed,%ld,%ld,%ld,%ld\n", u[LVL_ERROR], u[LVL_WARNING],
+                   u[LVL_INFO], u[LVL_OTHER]);
+        else
+            printf("%-20s  ERROR=%-6ld WARNING=%-6ld INFO=%-6ld OTHER=%ld\n", "(no timestamp)",
+                   u[LVL_ERROR], u[LVL_WARNING], u[LVL_INFO], u[LVL_OTHER]);
+    }
+}
+
+// ---- sidecar index ----
+//
+// Layout of <logfile>.idx:
+//   index_header
+//   index_block[nblocks]                     per-block offset and level counts
+//   uint64_t samples[nsamples]               byte offset of every INDEX_SAMPLE_LINES-th line
+//   uint64_t bitmaps[nblocks][LVL_OTHER][INDEX_BITMAP_WORDS]  one bit per line and level
+#define INDEX_MAGIC        "LAIDX01"
+#define INDEX_BLOCK_LINES  4096
+#define INDEX_SAMPLE_LINES 64
+#define INDEX_BITMAP_WORDS (INDEX_BLOCK_LINES / 64)
+#define INDEX_BLOCK_BITS   (LVL_OTHER * INDEX_BITMAP_WORDS)
+
+struct index_header {
+    char magic[8];
+    uint32_t block_lines;
+    uint32_t sample_lines;
+    uint64_t file_size;     // size and mtime of the log when the index was built
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    uint64_t total_lines;
+    uint64_t nblocks;
+    uint64_t nsamples;
+    uint64_t totals[LVL_COUNT];
+};
+
+struct index_block {
+    uint64_t offset;        // byte offset of the block's first line
+    uint32_t nlines;
+    uint32_t counts[LVL_COUNT];
+};
+
+struct log_index {
+    struct mapped_file file;
+    const struct index_header *hdr;
+    const struct index_block *blocks;
+    const uint64_t *samples;
+    const uint64_t *bitmaps;
+};
+
+// dynamic arrays used while building
+struct index_builder {
+    struct index_block *blocks;
+    uint64_t *samples;
+    uint64_t *bitmaps;
+    size_t nblocks, block_cap;
+    size_t nsamples, sample_cap;
+};
+
+static int builder_new_block(struct index_builder *b, uint64_t offset) {
+    if (b->nblocks == b->block_cap) {
+        size_t cap = b->block_cap ? b->block_cap * 2 : 64;
+        struct index_block *nb = realloc(b->blocks, cap * sizeof(*nb));
+        uint64_t *bm = realloc(b->bitmaps, cap * INDEX_BLOCK_BITS * sizeof(*bm));
+        if (nb) b->blocks = nb;
+        if (bm) b->bitmaps = bm;
+        if (!nb || !bm)
+            return -1;
+        b->block_cap = cap;
+    }
+    memset(&b->blocks[b->nblocks], 0, sizeof(*b->blocks));
+    memset(&b->bitmaps[b->nblocks * INDEX_BLOCK_BITS], 0, INDEX_BLOCK_BITS * sizeof(uint64_t));
+    b->blocks[b->nblocks].offset = offset;
+    b->nblocks++;
+    return 0;
+}
+
+static int builder_add_sample(struct index_builder *b, uint64_t offset) {
+    if (b->nsamples == b->sample_cap) {
+        size_t cap = b->sample_cap ? b->sample_cap * 2 : 1024;
+        uint64_t *ns = realloc(b->samples, cap * sizeof(*ns));
+        if (!ns)
+            return -1;
+        b->samples = ns;
+        b->sample_cap = cap;
+    }
+    b->samples[b->nsamples++] = offset;
+    return 0;
+}
+
+static void default_index_path(const char *logfile, char *out, size_t cap) {
+    snprintf(out, cap, "%s.idx", logfile);
+}
+
+// scan the whole log once and write its sidecar index
+static int build_index(const char *idx_path, const char *map, const struct stat *sb) {
+    struct index_builder b;
+    memset(&b, 0, sizeof(b));
+
+    struct index_header hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    hdr.block_lines = INDEX_BLOCK_LINES;
+    hdr.sample_lines = INDEX_SAMPLE_LINES;
+    hdr.file_size = (uint64_t)sb->st_size;
+    hdr.mtime_sec = sb->st_mtim.tv_sec;
+    hdr.mtime_nsec = sb->st_mtim.tv_nsec;
+
+    int rc = -1;
+    const char *p = map, *end = map + sb->st_size;
+    uint64_t line = 0;
+
+    while (p < end) {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        const char *line_end = nl ? nl : end;
+        uint64_t offset = (uint64_t)(p - map);
+
+        if (line % INDEX_SAMPLE_LINES == 0 && builder_add_sample(&b, offset) == -1)
+            goto out;
+        if (line % INDEX_BLOCK_LINES == 0 && builder_new_block(&b, offset) == -1)
+            goto out;
+
+        const char *msg = p;
+        int level = classify_line(&msg, line_end);
+        struct index_block *blk = &b.blocks[b.nblocks - 1];
+        uint32_t bit = (uint32_t)(line % INDEX_BLOCK_LINES);
+
+        blk->nlines++;
+        blk->counts[level]++;
+        hdr.totals[level]++;
+        if (level != LVL_OTHER) {
+            uint64_t *bm = &b.bitmaps[(b.nblocks - 1) * INDEX_BLOCK_BITS + level * INDEX_BITMAP_WORDS];
+            bm[bit / 64] |= 1ULL << (bit % 64);
+        }
+
+        line++;
+        p = nl ? nl + 1 : end;
+    }
+
+    hdr.total_lines = line;
+    hdr.nblocks = b.nblocks;
+    hdr.nsamples = b.nsamples;
+
+    // write to a temp file and rename, so readers never see a half-written index
+    char tmp_path[4096];
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", idx_path) >= (int)sizeof(tmp_path)) {
+        errno = ENAMETOOLONG;
+        goto out;
+    }
+    FILE *f = fopen(tmp_path, "wb");
+    if (!f)
+        goto out;
+
+    int ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1 &&
+             fwrite(b.blocks, sizeof(*b.blocks), b.nblocks, f) == b.nblocks &&
+             fwrite(b.samples, sizeof(*b.samples), b.nsamples, f) == b.nsamples &&
+             fwrite(b.bitmaps, sizeof(uint64_t) * INDEX_BLOCK_BITS, b.nblocks, f) == b.nblocks;
+    if (fclose(f) != 0)
+        ok = 0;
+    if (!ok || rename(tmp_path, idx_path) == -1) {
+        int saved = errno;
+        unlink(tmp_path);
+        errno = saved;
+        goto out;
+    }
+
+    printf("Index: %s (%llu lines, %llu blocks)\n", idx_path,
+           (unsigned long long)hdr.total_lines, (unsigned long long)hdr.nblocks);
+    rc = 0;
+
+out:
+    free(b.blocks);
+    free(b.samples);
+    free(b.bitmaps);
+    return rc;
+}
+
+// a header's counts must agree with each other, with the file size and with
+// the blocks, since the queries index blocks[] and samples[] by line number
+static int index_valid(const struct index_header *h, size_t size) {
+    uint64_t lines = h->total_lines;
+    if (h->nblocks != lines / INDEX_BLOCK_LINES + (lines % INDEX_BLOCK_LINES != 0) ||
+        h->nsamples != lines / INDEX_SAMPLE_LINES + (lines % INDEX_SAMPLE_LINES != 0))
+        return 0;
+
+    uint64_t blocks_len, bitmaps_len, samples_len, expected;
+    if (__builtin_mul_overflow(h->nblocks, sizeof(struct index_block), &blocks_len) ||
+        __builtin_mul_overflow(h->nblocks, INDEX_BLOCK_BITS * sizeof(uint64_t), &bitmaps_len) ||
+        __builtin_mul_overflow(h->nsamples, sizeof(uint64_t), &samples_len) ||
+        __builtin_add_overflow(sizeof(*h), blocks_len, &expected) ||
+        __builtin_add_overflow(expected, bitmaps_len, &expected) ||
+        __builtin_add_overflow(expected, samples_len, &expected) ||
+        expected != size)
+        return 0;
+
+    // every block but the last is full, its level counts add up to its
+    // lines, and line offsets stay inside the log
+    const struct index_block *blocks = (const struct index_block *)(h + 1);
+    const uint64_t *samples = (const uint64_t *)(blocks + h->nblocks);
+    uint64_t sum = 0;
+    for (uint64_t i = 0; i < h->nblocks; i++) {
+        const struct index_block *bl = &blocks[i];
+        uint64_t levels = 0;
+        for (int l = 0; l < LVL_COUNT; l++)
+            levels += bl->counts[l];
+        if (bl->nlines == 0 || bl->nlines > INDEX_BLOCK_LINES ||
+            (i + 1 < h->nblocks && bl->nlines != INDEX_BLOCK_LINES) ||
+            levels != bl->nlines || bl->offset >= h->file_size)
+            return 0;
+        sum += bl->nlines;
+    }
+    if (sum != lines)
+        return 0;
+    for (uint64_t i = 0; i < h->nsamples; i++)
+        if (samples[i] >= h->file_size)
+            return 0;
+    return 1;
+}
+
+// map an index; returns 0 on success, -1 if unreadable/corrupt, -2 if stale
+static int index_open(struct log_index *ix, const char *idx_path, const struct stat *log_sb) {
+    memset(ix, 0, sizeof(*ix));
+
+    // queries jump straight to the blocks they need
+    const char *map;
+    size_t size;
+    if (mf_open(&ix->file, idx_path, MF_RANDOM) == -1)
+        return -1;
+    if (mf_map_all(&ix->file, &map, &size) == -1 || size < sizeof(struct index_header)) {
+        mf_close(&ix->file);
+        return -1;
+    }
+    ix->hdr = (const struct index_header *)map;
+
+    const struct index_header *h = ix->hdr;
+    if (memcmp(h->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 ||
+        h->block_lines != INDEX_BLOCK_LINES || h->sample_lines != INDEX_SAMPLE_LINES ||
+        !index_valid(h, size)) {
+        mf_close(&ix->file);
+        return -1;
+    }
+
+    if (h->file_size != (uint64_t)log_sb->st_size ||
+        h->mtime_sec != log_sb->st_mtim.tv_sec || h->mtime_nsec != log_sb->st_mtim.tv_nsec) {
+        mf_close(&ix->file);
+        return -2;
+    }
+
+    ix->blocks = (const struct index_block *)(h + 1);
+    ix->samples = (const uint64_t *)(ix->blocks + h->nblocks);
+    ix->bitmaps = ix->samples + h->nsamples;
+    return 0;
+}
+
+static void index_close(struct log_index *ix) {
+    mf_close(&ix->file);
+}
+
+static const uint64_t *index_bitmap(const struct log_index *ix, uint64_t blk, int level) {
+    return ix->bitmaps + blk * INDEX_BLOCK_BITS + (uint64_t)level * INDEX_BITMAP_WORDS;
+}
+
+// number of set bits in [lo, hi) of a block bitmap
+static uint64_t popcount_range(const uint64_t *bm, uint32_t lo, uint32_t hi) {
+    uint64_t n = 0;
+    while (lo < hi) {
+        uint32_t w = lo / 64, b = lo % 64;
+        uint32_t take = 64 - b;
+        if (take > hi - lo)
+            take = hi - lo;
+        uint64_t mask = (take == 64) ? ~0ULL : (((1ULL << take) - 1) << b);
+        n += (uint64_t)__builtin_popcountll(bm[w] & mask);
+        lo += take;
+    }
+    return n;
+}
+
+// per-level counts for lines [a, b), 0-based
+static void index_count_lines(const struct log_index *ix, uint64_t a, uint64_t b,
+                              uint64_t out[LVL_COUNT]) {
+    memset(out, 0, LVL_COUNT * sizeof(*out));
+    if (b > ix->hdr->total_lines)
+        b = ix->hdr->total_lines;
+    if (a >= b)
+        return;
+
+    for (uint64_t blk = a / INDEX_BLOCK_LINES; blk <= (b - 1) / INDEX_BLOCK_LINES; blk++) {
+        const struct index_block *bl = &ix->blocks[blk];
+        uint64_t first = blk * INDEX_BLOCK_LINES;
+        uint32_t lo = a > first ? (uint32_t)(a - first) : 0;
+        uint32_t hi = b < first + bl->nlines ? (uint32_t)(b - first) : bl->nlines;
+
+        if (lo == 0 && hi == bl->nlines) {
+            // whole block: the counts are enough, no need to touch the bitmaps
+            for (int l = 0; l < LVL_COUNT; l++)
+                out[l] += bl->counts[l];
+            continue;
+        }
+
+        uint64_t known = 0;
+        for (int l = 0; l < LVL_OTHER; l++) {
+            uint64_t n = popcount_range(index_bitmap(ix, blk, l), lo, hi);
+            out[l] += n;
+            known += n;
+        }
+        out[LVL_OTHER] += (hi - lo) - known;
+    }
+}
+
+// byte offset of a 0-based line, starting from the nearest sample
+static uint64_t index_line_offset(const struct log_index *ix, const char *map, uint64_t line) {
+    uint64_t off = ix->samples[line / INDEX_SAMPLE_LINES];
+    for (uint64_t i = line - line % INDEX_SAMPLE_LINES; i < line; i++) {
+        const char *nl = memchr(map + off, '\n', ix->hdr->file_size - off);
+        off = (uint64_t)(nl - map) + 1;
+    }
+    return off;
+}
+
+// first 0-based line that starts at or after byte offset off
+static uint64_t index_line_at(const struct log_index *ix, const char *map, uint64_t off) {
+    const struct index_header *h = ix->hdr;
+    if (h->nsamples == 0 || off >= h->file_size)
+        return h->total_lines;
+
+    // last sample starting at or before off
+    uint64_t lo = 0, hi = h->nsamples;
+    while (hi - lo > 1) {
+        uint64_t mid = (lo + hi) / 2;
+        if (ix->samples[mid] <= off)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    uint64_t line = lo * INDEX_SAMPLE_LINES;
+    uint64_t pos = ix->samples[lo];
+    while (pos < off && line < h->total_lines) {
+        const char *nl = memchr(map + pos, '\n', h->file_size - pos);
+        pos = nl ? (uint64_t)(nl - map) + 1 : h->file_size;
+        line++;
+    }
+    return line;
+}
+
+// 0-based line number of the nth (1-based) line of a level, or -1 if there are fewer
+static int64_t index_find_nth(const struct log_index *ix, int level, uint64_t n) {
+    if (n == 0 || n > ix->hdr->totals[level])
+        return -1;
+
+    for (uint64_t blk = 0; blk < ix->hdr->nblocks; blk++) {
+        uint32_t c = ix->blocks[blk].counts[level];
+        if (n > c) {
+            n -= c;
+            continue;
+        }
+
+        const uint64_t *bm = index_bitmap(ix, blk, level);
+        for (uint32_t w = 0; w < INDEX_BITMAP_WORDS; w++) {
+            uint64_t word = bm[w];
+            uint64_t pc = (uint64_t)__builtin_popcountll(word);
+            if (n > pc) {
+                n -= pc;
+                continue;
+            }
+            while (--n)
+                word &= word - 1;
+            return (int64_t)(blk * INDEX_BLOCK_LINES + w * 64 + __builtin_ctzll(word));
+        }
+    }
+    return -1;
+}
+
+static void print_level_counts(const uint64_t c[LVL_COUNT]) {
+    printf("ERROR=%llu WARNING=%llu INFO=%llu OTHER=%llu\n",
+           (unsigned long long)c[LVL_ERROR], (unsigned long long)c[LVL_WARNING],
+           (unsigned long long)c[LVL_INFO], (unsigned long long)c[LVL_OTHER]);
+}
+
+// parse "A:B" into two unsigned numbers
+static int parse_range(const char *s, uint64_t *a, uint64_t *b) {
+    char *endp;
+    errno = 0;
+    *a = strtoull(s, &endp, 10);
+    if (endp == s || *endp != ':')
+        return -1;
+    s = endp + 1;
+    *b = strtoull(s, &endp, 10);
+    if (endp == s || *endp != '\0' || errno)
+        return -1;
+    return 0;
+}
+
+// parse "LEVEL:N" for --nth
+static int parse_nth(const char *s, int *level, uint64_t *n) {
+    const char *colon = strchr(s, ':');
+    if (!colon)
+        return -1;
+    *level = -1;
+    for (int l = 0; l < LVL_OTHER; l++)
+        if ((size_t)(colon - s) == level_lens[l] && strncasecmp(s, level_names[l], level_lens[l]) == 0)
+            *level = l;
+    if (*level < 0)
+        return -1;
+    char *endp;
+    *n = strtoull(colon + 1, &endp, 10);
+    return (endp == colon + 1 || *endp != '\0' || *n == 0) ? -1 : 0;
+}
+
+// index queries requested on the command line
+struct index_query {
+    int count;
+    const char *lines;
+    const char *bytes;
+    const char *nth;
+};
+
+static int run_index_queries(const struct log_index *ix, const char *map,
+                             const struct index_query *q) {
+    const struct index_header *h = ix->hdr;
+    uint64_t c[LVL_COUNT];
+
+    if (q->count) {
+        printf("Indexed lines: %llu\n", (unsigned long long)h->total_lines);
+        printf("ERROR lines: %llu\nWARNING lines: %llu\nINFO lines: %llu\nOther lines: %llu\n",
+               (unsigned long long)h->totals[LVL_ERROR], (unsigned long long)h->totals[LVL_WARNING],
+               (unsigned long long)h->totals[LVL_INFO], (unsigned long long)h->totals[LVL_OTHER]);
+    }
+
+    if (q->lines) {
+        uint64_t a, b;
+        if (parse_range(q->lines, &a, &b) == -1 || a == 0 || b < a) {
+            fprintf(stderr, "Error: --lines expects FIRST:LAST (1-based, inclusive).\n");
+            return 1;
+        }
+        index_count_lines(ix, a - 1, b, c);
+        printf("Lines %llu-%llu: ", (unsigned long long)a, (unsigned long long)b);
+        print_level_counts(c);
+    }
+
+    if (q->bytes) {
+        uint64_t a, b;
+        if (parse_range(q->bytes, &a, &b) == -1 || b < a) {
+            fprintf(stderr, "Error: --bytes expects START:END (byte offsets, END exclusive).\n");
+            return 1;
+        }
+        uint64_t la = index_line_at(ix, map, a), lb = index_line_at(ix, map, b);
+        index_count_lines(ix, la, lb, c);
+        printf("Bytes %llu-%llu (%llu lines): ", (unsigned long long)a, (unsigned long long)b,
+               (unsigned long long)(lb - la));
+        print_level_counts(c);
+    }
+
+    if (q->nth) {
+        int level;
+        uint64_t n;
+        if (parse_nth(q->nth, &level, &n) == -1) {
+            fprintf(stderr, "Error: --nth expects LEVEL:N, e.g. ERROR:3.\n");
+            return 1;
+        }
+        int64_t line = index_find_nth(ix, level, n);
+        if (line < 0) {
+            printf("%s #%llu: not found (%llu in file)\n", level_names[level],
+                   (unsigned long long)n, (unsigned long long)h->totals[level]);
+        } else {
+            uint64_t off = index_line_offset(ix, map, (uint64_t)line);
+            const char *nl = memchr(map + off, '\n', h->file_size - off);
+            size_t len = nl ? (size_t)(nl - (map + off)) : (size_t)(h->file_size - off);
+            printf("%s #%llu at line %llu: %.*s\n", level_names[level], (unsigned long long)n,
+                   (unsigned long long)line + 1, (int)len, map + off);
+        }
+    }
+    return 0;
+}
+
+// ---- multi-file counting ----
+
+#define CHUNK_SIZE (32UL * 1024 * 1024)   // files over twice this are split into chunks
+
+// mf_open() flags for log files; --populate and --hugepages add to them
+static int log_map_flags = MF_SEQUENTIAL;
+
+struct counts {
+    uint64_t lines, words, chars;
+    uint64_t err, warn, info;
+};
+
+// one input file and its results
+struct log_file {
+    char *path;
+    size_t size;
+    int error;          // errno of a failed stat/open/mmap, 0 if fine
+    struct mapped_file mf;  // opened up front for chunked files
+    const char *map;        // mapping of mf, NULL otherwise
+    struct counts counts;
+};
+
+struct file_list {
+    struct log_file *files;
+    size_t n, cap;
+    int missed;         // a glob operand matched nothing: exit 2 like a missing file
+};
+
+// count [start, end) of a mapped file; looks at the byte before start and past end,
+// so the chunks of a file add up to exactly its whole-file counts
+static void count_range(const char *map, size_t size, size_t start, size_t end, struct counts *c) {
+    for (size_t i = start; i < end; i++) {
+        char ch = map[i];
+        c->chars++;
+
+        if (ch == '\n')
+            c->lines++;
+
+        if ((ch == ' ' || ch == '\n' || ch == '\t') &&
+            (i > 0 && map[i-1] != ' ' && map[i-1] != '\n' && map[i-1] != '\t'))
+            c->words++;
+
+        // Count ERROR/WARNING/INFO
+        if (ch == 'E' && i + 5 < size && memcmp(&map[i], "ERROR", 5) == 0) c->err++;
+        if (ch == 'W' && i + 7 < size && memcmp(&map[i], "WARNING", 7) == 0) c->warn++;
+        if (ch == 'I' && i + 4 < size && memcmp(&map[i], "INFO", 4) == 0) c->info++;
+    }
+}
+
+#define KEYWORD_MAX 7       // length of "WARNING", the longest keyword
+
+// count a whole file one mf_next() block at a time, so pipes are never read
+// into memory in full. count_range() needs the byte before each position and
+// up to KEYWORD_MAX bytes after it, so the last bytes of every block are held
+// back in edge[] and counted together with the start of the next block.
+static int count_blocks(struct mapped_file *mf, struct counts *c) {
+    char edge[1 + KEYWORD_MAX + KEYWORD_MAX + 1];
+    size_t held = 0;
+    edge[0] = ' ';          // no byte before the file: no word ends at offset 0
+
+    for (;;) {
+        const char *blk;
+        ssize_t got = mf_next(mf, &blk);
+        if (got == -1)
+            return -1;
+        size_t n = (size_t)got;
+        if (n == 0) {
+            count_range(edge, 1 + held, 1, 1 + held, c);
+            return 0;
+        }
+
+        // held bytes and blk[0]; a block shorter than take is the last one
+        size_t take = n < KEYWORD_MAX + 1 ? n : KEYWORD_MAX + 1;
+        memcpy(edge + 1 + held, blk, take);
+        count_range(edge, 1 + held + take, 1, 2 + held, c);
+
+        // the middle of the block has all its context in the block itself
+        size_t tail = n > KEYWORD_MAX + 1 ? n - KEYWORD_MAX : 1;
+        if (tail > 1)
+            count_range(blk, n, 1, tail, c);
+
+        held = n - tail;
+        edge[0] = blk[tail - 1];
+        memcpy(edge + 1, blk + tail, held);
+    }
+}
+
+static void add_counts(struct counts *dst, const struct counts *src) {
+    dst->lines += src->lines;
+    dst->words += src->words;
+    dst->chars += src->chars;
+    dst->err += src->err;
+    dst->warn += src->warn;
+    dst->info += src->info;
+}
+
+// chunks of the same file finish on different threads
+static void add_counts_atomic(struct counts *dst, const struct counts *src) {
+    __atomic_fetch_add(&dst->lines, src->lines, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&dst->words, src->words, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&dst->chars, src->chars, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&dst->err, src->err, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&dst->warn, src->warn, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&dst->info, src->info, __ATOMIC_RELAXED);
+}
+
+static int file_list_add(struct file_list *fl, const char *path) {
+    if (fl->n == fl->cap) {
+        size_t cap = fl->cap ? fl->cap * 2 : 16;
+        struct log_file *nf = realloc(fl->files, cap * sizeof(*nf));
+        if (!nf)
+            return -1;
+        fl->files = nf;
+        fl->cap = cap;
+    }
+
+    struct log_file *f = &fl->files[fl->n];
+    memset(f, 0, sizeof(*f));
+    f->path = strdup(path);
+    if (!f->path)
+        return -1;
+
+    // "-" is standard input; its size is only known once it has been read
+    struct stat sb;
+    if (strcmp(path, "-") == 0)
+        f->size = 0;
+    else if (stat(path, &sb) == -1)
+        f->error = errno;
+    else
+        f->size = (size_t)sb.st_size;
+    fl->n++;
+    return 0;
+}
+
+static void file_list_free(struct file_list *fl) {
+    for (size_t i = 0; i < fl->n; i++)
+        free(fl->files[i].path);
+    free(fl->files);
+}
+
+static int cmp_file_path(const void *a, const void *b) {
+    return strcmp(((const struct log_file *)a)->path, ((const struct log_file *)b)->path);
+}
+
+static int has_suffix(const char *s, const char *suffix) {
+    size_t n = strlen(s), m = strlen(suffix);
+    return n >= m && strcmp(s + n - m, suffix) == 0;
+}
+
+// nftw() has no user pointer, so directory walks collect into this list
+static struct file_list *walk_list;
+
+static int walk_cb(const char *path, const struct stat *sb, int type, struct FTW *ftw) {
+    (void)sb;
+    (void)ftw;
+    // skip our own sidecar indexes when scanning a log directory
+    if (type != FTW_F || has_suffix(path, ".idx") || has_suffix(path, ".idx.tmp"))
+        return 0;
+    return file_list_add(walk_list, path) == -1 ? -1 : 0;
+}
+
+static int expand_one(struct file_list *fl, const char *path) {
+    struct stat sb;
+    if (stat(path, &sb) == 0 && S_ISDIR(sb.st_mode)) {
+        size_t first = fl->n;
+        walk_list = fl;
+        if (nftw(path, walk_cb, 64, FTW_PHYS) == -1)
+            return -1;
+        qsort(fl->files + first, fl->n - first, sizeof(*fl->files), cmp_file_path);
+        return 0;
+    }
+    return file_list_add(fl, path);
+}
+
+// turn file, glob and directory operands into a flat list of files
+static int expand_paths(struct file_list *fl, char **args, int nargs) {
+    for (int i = 0; i < nargs; i++) {
+        if (!strpbrk(args[i], "*?[")) {
+            if (expand_one(fl, args[i]) == -1)
+                return -1;
+            continue;
+        }
+
+        glob_t g;
+        int rc = glob(args[i], 0, NULL, &g);
+        if (rc == GLOB_NOMATCH) {
+            fprintf(stderr, "Error: no files match %s\n", args[i]);
+            fl->missed = 1;
+            continue;
+        }
+        if (rc != 0) {
+            globfree(&g);
+            return -1;
+        }
+        for (size_t j = 0; j < g.gl_pathc; j++) {
+            if (expand_one(fl, g.gl_pathv[j]) == -1) {
+                globfree(&g);
+                return -1;
+            }
+        }
+        globfree(&g);
+    }
+    return 0;
+}
+
+// small files are scanned whole by one worker; large files are split into chunks
+struct task {
+    struct log_file *file;
+    size_t start, end;
+    int whole;
+};
+
+// each worker pops from the tail of its own deque and steals from the head of others
+struct task_deque {
+    pthread_mutex_t lock;
+    struct task *tasks;
+    size_t head, tail, cap;
+};
+
+struct pool {
+    struct task_deque *deques;
+    int nworkers;
+};
+
+struct worker_arg {
+    struct pool *pool;
+    int id;
+};
+
+static int deque_push(struct task_deque *d, struct task t) {
+    if (d->tail == d->cap) {
+        size_t cap = d->cap ? d->cap * 2 : 64;
+        struct task *nt = realloc(d->tasks, cap * sizeof(*nt));
+        if (!nt)
+            return -1;
+        d->tasks = nt;
+        d->cap = cap;
+    }
+    d->tasks[d->tail++] = t;
+    return 0;
+}
+
+static int deque_pop(struct task_deque *d, struct task *out, int steal) {
+    int ok = 0;
+    pthread_mutex_lock(&d->lock);
+    if (d->head < d->tail) {
+        *out = steal ? d->tasks[d->head++] : d->tasks[--d->tail];
+        ok = 1;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return ok;
+}
+
+static void run_task(const struct task *t) {
+    struct log_file *f = t->file;
+    struct counts c;
+    memset(&c, 0, sizeof(c));
+
+    if (!t->whole) {
+        count_range(f->map, f->size, t->start, t->end, &c);
+        add_counts_atomic(&f->counts, &c);
+        return;
+    }
+
+    struct mapped_file mf;
+    if (mf_open(&mf, f->path, log_map_flags) == -1) {
+        f->error = errno;
+        return;
+    }
+    if (count_blocks(&mf, &c) == -1)
+        f->error = errno;
+    f->size = (size_t)mf.pos;
+    mf_close(&mf);
+    f->counts = c;
+}
+
+static void *worker_main(void *arg) {
+    struct worker_arg *wa = arg;
+    struct pool *p = wa->pool;
+    struct task t;
+
+    for (;;) {
+        if (deque_pop(&p->deques[wa->id], &t, 0)) {
+            run_task(&t);
+            continue;
+        }
+
+        // own deque is empty: try to steal; all tasks are queued up front,
+        // so one empty sweep means there is nothing left to do
+        int found = 0;
+        for (int k = 1; k < p->nworkers && !found; k++)
+            found = deque_pop(&p->deques[(wa->id + k) % p->nworkers], &t, 1);
+        if (!found)
+            return NULL;
+        run_task(&t);
+    }
+}
+
+static int cmp_file_size_desc(const void *a, const void *b) {
+    const struct log_file *x = *(const struct log_file *const *)a;
+    const struct log_file *y = *(const struct log_file *const *)b;
+    return x->size < y->size ? 1 : (x->size > y->size ? -1 : 0);
+}
+
+// map files that will be chunked; small files are opened by the worker that scans them
+static void map_for_chunks(struct log_file *f) {
+    size_t size;
+    if (mf_open(&f->mf, f->path, log_map_flags) == -1) {
+        f->error = errno;
+        return;
+    }
+    if (mf_map_all(&f->mf, &f->map, &size) == -1) {
+        f->error = errno;
+        mf_close(&f->mf);
+        f->map = NULL;
+        return;
+    }
+    f->size = size;     // the file may have changed since it was listed
+    if (!f->map)
+        mf_close(&f->mf);   // truncated to empty: nothing to chunk, and out: only closes mapped files
+}
+
+// scan every file on a pool of nthreads workers
+static int count_files(struct file_list *fl, int nthreads) {
+    struct log_file **order = malloc((fl->n ? fl->n : 1) * sizeof(*order));
+    struct pool p;
+    p.nworkers = nthreads;
+    p.deques = calloc((size_t)nthreads, sizeof(*p.deques));
+    pthread_t *threads = calloc((size_t)nthreads, sizeof(*threads));
+    struct worker_arg *args = calloc((size_t)nthreads, sizeof(*args));
+    int rc = -1;
+
+    if (!order || !p.deques || !threads || !args)
+        goto out;
+
+    // largest files first, dealt round-robin so big chunks spread over all workers
+    for (size_t i = 0; i < fl->n; i++)
+        order[i] = &fl->files[i];
+    qsort(order, fl->n, sizeof(*order), cmp_file_size_desc);
+
+    for (int w = 0; w < nthreads; w++)
+        pthread_mutex_init(&p.deques[w].lock, NULL);
+
+    size_t next = 0;
+    for (size_t i = 0; i < fl->n; i++) {
+        struct log_file *f = order[i];
+        if (f->error)
+            continue;
+
+        if (f->size <= 2 * CHUNK_SIZE) {
+            struct task t = { f, 0, f->size, 1 };
+            if (deque_push(&p.deques[next++ % nthreads], t) == -1)
+                goto out;
+            continue;
+        }
+
+        map_for_chunks(f);
+        if (f->error || !f->map)
+            continue;
+        for (size_t off = 0; off < f->size; off += CHUNK_SIZE) {
+            size_t end = off + CHUNK_SIZE < f->size ? off + CHUNK_SIZE : f->size;
+            struct task t = { f, off, end, 0 };
+            if (deque_push(&p.deques[next++ % nthreads], t) == -1)
+                goto out;
+        }
+    }
+
+    int started = 0;
+    for (int w = 0; w < nthreads; w++) {
+        args[w].pool = &p;
+        args[w].id = w;
+        if (pthread_create(&threads[w], NULL, worker_main, &args[w]) != 0)
+            break;
+        started++;
+    }
+    // with no threads at all, drain the queues here
+    if (started == 0) {
+        for (int w = 0; w < nthreads; w++) {
+            struct task t;
+            while (deque_pop(&p.deques[w], &t, 0))
+                run_task(&t);
+        }
+    }
+    for (int w = 0; w < started; w++)
+        pthread_join(threads[w], NULL);
+    rc = 0;
+
+out:
+    for (size_t i = 0; i < fl->n; i++) {
+        if (fl->files[i].map) {
+            mf_close(&fl->files[i].mf);
+            fl->files[i].map = NULL;
+        }
+    }
+    if (p.deques) {
+        for (int w = 0; w < nthreads; w++) {
+            pthread_mutex_destroy(&p.deques[w].lock);
+            free(p.deques[w].tasks);
+        }
+    }
+    free(p.deques);
+    free(threads);
+    free(args);
+    free(order);
+    return rc;
+}
+
+static void print_counts(const char *label, const struct counts *c, int summary_only) {
+    if (summary_only) {
+        printf("%s%sSummary: %llu lines, %llu words, %llu chars, %llu ERR, %llu WARN, %llu INFO\n",
+               label ? label : "", label ? ": " : "",
+               (unsigned long long)c->lines, (unsigned long long)c->words,
+               (unsigned long long)c->chars, (unsigned long long)c->err,
+               (unsigned long long)c->warn, (unsigned long long)c->info);
+    } else {
+        if (label)
+            printf("File: %s\n", label);
+        printf("Lines: %llu\nWords: %llu\nCharacters: %llu\n", (unsigned long long)c->lines,
+               (unsigned long long)c->words, (unsigned long long)c->chars);
+        printf("ERROR entries: %llu\nWARNING entries: %llu\nINFO entries: %llu\n",
+               (unsigned long long)c->err, (unsigned long long)c->warn,
+               (unsigned long long)c->info);
+    }
+}
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// the default mode: per-file and aggregate counters for every input file
+static int run_counts(struct file_list *fl, int summary_only, int nthreads) {
+    double start = now_seconds();
+    if (count_files(fl, nthreads) == -1) {
+        perror("Error scheduling files");
+        return 2;
+    }
+    double elapsed = now_seconds() - start;
+
+    int rc = 0;
+    struct counts total;
+    memset(&total, 0, sizeof(total));
+    size_t ok = 0;
+    uint64_t bytes = 0;
+
+    for (size_t i = 0; i < fl->n; i++) {
+        struct log_file *f = &fl->files[i];
+        if (f->error) {
+            fprintf(stderr, "Error opening file %s: %s\n", f->path, strerror(f->error));
+            rc = 2;
+            continue;
+        }
+        if (fl->n == 1) {
+            // single file keeps the original output
+            if (summary_only)
+                print_counts(NULL, &f->counts, 1);
+            else
+                print_counts(f->path, &f->counts, 0);
+        } else {
+            print_counts(f->path, &f->counts, summary_only);
+            if (!summary_only)
+                printf("\n");
+        }
+        add_counts(&total, &f->counts);
+        bytes += f->size;
+        ok++;
+    }
+
+    if (fl->n > 1) {
+        char label[64];
+        snprintf(label, sizeof(label), "Total (%zu files)", ok);
+        if (summary_only) {
+            print_counts(label, &total, 1);
+        } else {
+            printf("%s:\n", label);
+            print_counts(NULL, &total, 0);
+        }
+    }
+
+    // a single file keeps its original stdout, so its throughput goes to stderr
+    if (ok > 0)
+        fprintf(fl->n > 1 ? stdout : stderr, "Scanned %.1f MB in %.3f s (%.2f GB/s, %d threads)\n",
+                bytes / 1e6, elapsed, elapsed > 0 ? bytes / 1e9 / elapsed : 0.0, nthreads);
+    return rc;
+}
+
+// open and map a whole log; an empty file gives a NULL map of size 0, and
+// pipes are read into memory
+static int map_log(const char *path, struct mapped_file *mf, const char **map, size_t *size) {
+    if (mf_open(mf, path, log_map_flags) == -1) {
+        fprintf(stderr, "Error opening file %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    if (mf_map_all(mf, map, size) == -1) {
+        fprintf(stderr, "Error mapping file %s: %s\n", path, strerror(errno));
+        mf_close(mf);
+        return -1;
+    }
+    return 0;
+}
+
+// --build-index and the index queries, one log at a time
+static int run_index(const char *filename, const char *index_path, int build,
+                     const struct index_query *query) {
+    char idx_buf[4096];
+    if (!index_path) {
+        default_index_path(filename, idx_buf, sizeof(idx_buf));
+        index_path = idx_buf;
+    }
+    int querying = query->count || query->lines || query->bytes || query->nth;
+
+    struct mapped_file mf;
+    const char *map;
+    size_t size;
+    if (map_log(filename, &mf, &map, &size) == -1)
+        return 2;
+    // the index is tied to the log's size and mtime, which a pipe does not have
+    if (!S_ISREG(mf.st.st_mode)) {
+        fprintf(stderr, "Error: %s is not a regular file; indexes need one.\n", filename);
+        mf_close(&mf);
+        return 2;
+    }
+
+    int rc = 0;
+    if (build && build_index(index_path, map, &mf.st) == -1) {
+        perror("Error building index");
+        rc = 2;
+    }
+
+    // queries only touch the log around the lines they ask for
+    if (rc == 0 && querying) {
+        struct log_index ix;
+        int irc = index_open(&ix, index_path, &mf.st);
+        if (irc != 0) {
+            fprintf(stderr, "Error: index %s is %s; run loganalyzer --build-index %s\n",
+                    index_path, irc == -2 ? "stale" : "missing, unreadable or corrupt", filename);
+            rc = 2;
+        } else {
+            rc = run_index_queries(&ix, map, query);
+            index_close(&ix);
+        }
+    }
+
+    mf_close(&mf);
+    return rc;
+}
+
+// histogram / template mode, aggregated over every input file
+static int run_analysis(struct analysis *an, struct file_list *fl) {
+    int rc = 0;
+    if (an->top_n > 0 && table_init(&an->templates, 1024) == -1) {
+        perror("Error allocating template table");
+        return 2;
+    }
+
+    for (size_t i = 0; i < fl->n; i++) {
+        struct mapped_file mf;
+        const char *map;
+        size_t size;
+        if (map_log(fl->files[i].path, &mf, &map, &size) == -1) {
+            rc = 2;
+            continue;
+        }
+        if (map && analyze_buffer(an, &mf, map, size) == -1) {
+            perror("Error analyzing file");
+            rc = 2;
+        }
+        mf_close(&mf);
+    }
+
+    if (!an->csv) {
+        if (fl->n == 1)
+            printf("File: %s\n", fl->files[0].path);
+        else
+            printf("Files: %zu\n", fl->n);
+    }
+    if (an->hist.interval > 0)
+        print_histogram(an);
+    if (an->hist.interval > 0 && an->top_n > 0)
+        printf("\n");
+    if (an->top_n > 0)
+        print_templates(an);
+
+    table_free(&an->templates);
+    free(an->hist.buckets);
+    return rc;
+}
 
 void usage() {
-    printf("Usage: loganalyzer [-s] <logfile>\n");
-    printf("  -s : summary only\n");
+    printf("Usage: loganalyzer [-s] [-j threads] <logfile|dir|glob>...\n");
+    printf("       loganalyzer [-H secs] [-t N] [-f format] [-c] <logfile|dir|glob>...\n");
+    printf("       loganalyzer --build-index [--index path] <logfile>\n");
+    printf("       loganalyzer [--count] [--lines A:B] [--bytes A:B] [--nth LEVEL:N] <logfile>\n");
+    printf("  -s        : summary only\n");
+    printf("  -j N      : scan with N threads (default: one per CPU; -H and -t use one)\n");
+    printf("  -H secs   : per-level histogram in buckets of secs seconds\n");
+    printf("  -t N      : top N message templates\n");
+    printf("  -f format : strptime(3) format of the timestamp prefix (default \"%s\")\n",
+           DEFAULT_TS_FORMAT);
+    printf("  -c        : CSV output for -H and -t\n");
+    printf("  --build-index : write a sidecar index (default <logfile>.idx)\n");
+    printf("  --index path  : index file to build or query\n");
+    printf("  --count       : per-level line totals from the index\n");
+    printf("  --lines A:B   : per-level counts for lines A..B (1-based, inclusive)\n");
+    printf("  --bytes A:B   : per-level counts for lines starting in bytes [A, B)\n");
+    printf("  --nth LEVEL:N : print the Nth line of LEVEL, e.g. ERROR:3\n");
+    printf("  --io-stats    : print mmap/read/prefetch counters and page faults to stderr\n");
+    printf("  --populate    : fault every mapping in up front (MAP_POPULATE)\n");
+    printf("  --hugepages   : ask for transparent huge pages (MADV_HUGEPAGE)\n");
 }
 
 int main(int argc, char *argv[]) {
     int summary_only = 0;
+    int nthreads = 0;
+    int build = 0;
+    int io_stats = 0;
+    const char *index_path = NULL;
+    struct index_query query;
+    memset(&query, 0, sizeof(query));
+    struct analysis an;
+    memset(&an, 0, sizeof(an));
+    an.ts_format = DEFAULT_TS_FORMAT;
+
+    enum { OPT_BUILD_INDEX = 256, OPT_INDEX, OPT_COUNT, OPT_LINES, OPT_BYTES, OPT_NTH, OPT_IO_STATS,
+           OPT_POPULATE, OPT_HUGEPAGES };
+    static const struct option long_opts[] = {
+        { "build-index", no_argument,       NULL, OPT_BUILD_INDEX },
+        { "index",       required_argument, NULL, OPT_INDEX },
+        { "count",       no_argument,       NULL, OPT_COUNT },
+        { "lines",       required_argument, NULL, OPT_LINES },
+        { "bytes",       required_argument, NULL, OPT_BYTES },
+        { "nth",         required_argument, NULL, OPT_NTH },
+        { "io-stats",    no_argument,       NULL, OPT_IO_STATS },
+        { "populate",    no_argument,       NULL, OPT_POPULATE },
+        { "hugepages",   no_argument,       NULL, OPT_HUGEPAGES },
+        { NULL, 0, NULL, 0 }
+    };
 
     // Parse flags
     int opt;
-    while ((opt = getopt(argc, argv, "hs")) != -1) {
+    while ((opt = getopt_long(argc, argv, "hsH:t:f:cj:", long_opts, NULL)) != -1) {
         switch (opt) {
             case 'h':
                 usage();
@@ -25,6 +1630,60 @@ int main(int argc, char *argv[]) {
             case 's':
                 summary_only = 1;
                 break;
+            case 'H':
+                an.hist.interval = atol(optarg);
+                if (an.hist.interval <= 0) {
+                    fprintf(stderr, "Error: -H interval must be a positive number of seconds.\n");
+                    return 1;
+                }
+                break;
+            case 't':
+                an.top_n = atoi(optarg);
+                if (an.top_n <= 0) {
+                    fprintf(stderr, "Error: -t value must be positive.\n");
+                    return 1;
+                }
+                break;
+            case 'f':
+                an.ts_format = optarg;
+                break;
+            case 'c':
+                an.csv = 1;
+                break;
+            case 'j':
+                nthreads = atoi(optarg);
+                if (nthreads <= 0) {
+                    fprintf(stderr, "Error: -j value must be positive.\n");
+                    return 1;
+                }
+                break;
+            case OPT_BUILD_INDEX:
+                build = 1;
+                break;
+            case OPT_INDEX:
+                index_path = optarg;
+                break;
+            case OPT_COUNT:
+                query.count = 1;
+                break;
+            case OPT_LINES:
+                query.lines = optarg;
+                break;
+            case OPT_BYTES:
+                query.bytes = optarg;
+                break;
+            case OPT_NTH:
+                query.nth = optarg;
+                break;
+            case OPT_IO_STATS:
+                io_stats = 1;
+                break;
+            case OPT_POPULATE:
+                log_map_flags |= MF_POPULATE;
+                break;
+            case OPT_HUGEPAGES:
+                log_map_flags |= MF_HUGEPAGE;
+                break;
             default:
                 usage();
                 return 1;
@@ -38,63 +1697,48 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
-    char *filename = argv[optind];
-
-    // Open log file
-    int fd = open(filename, O_RDONLY);
-    if (fd == -1) {
-        perror("Error opening file");
-        return 2;
-    }
-
-    // Get file size
-    struct stat sb;
-    if (fstat(fd, &sb) == -1) {
-        perror("Error getting file size");
-        close(fd);
+    struct file_list files;
+    memset(&files, 0, sizeof(files));
+    if (expand_paths(&files, argv + optind, argc - optind) == -1) {
+        perror("Error expanding paths");
+        file_list_free(&files);
         return 2;
     }
-
-    // mmap file
-    char *map = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
-    if (map == MAP_FAILED) {
-        perror("Error mapping file");
-        close(fd);
+    if (files.n == 0) {
+        fprintf(stderr, "Error: No logfile found.\n");
+        file_list_free(&files);
         return 2;
     }
 
-    // Counters
-    int lines = 0, words = 0, chars = 0;
-    int err = 0, warn = 0, info = 0;
-
-    // Parse mapped memory
-    for (off_t i = 0; i < sb.st_size; i++) {
-        char c = map[i];
-        chars++;
-
-        if (c == '\n')
-            lines++;
-
-        if ((c == ' ' || c == '\n' || c == '\t') &&
-            (i > 0 && map[i-1] != ' ' && map[i-1] != '\n' && map[i-1] != '\t'))
-            words++;
+    int rc = 0;
+    int querying = query.count || query.lines || query.bytes || query.nth;
 
-        // Count ERROR/WARNING/INFO
-        if (i + 5 < sb.st_size && strncmp(&map[i], "ERROR", 5) == 0) err++;
-        if (i + 7 < sb.st_size && strncmp(&map[i], "WARNING", 7) == 0) warn++;
-        if (i + 4 < sb.st_size && strncmp(&map[i], "INFO", 4) == 0) info++;
-    }
-
-    if (summary_only) {
-        printf("Summary: %d lines, %d words, %d chars, %d ERR, %d WARN, %d INFO\n",
-               lines, words, chars, err, warn, info);
+    if (build || querying) {
+        if (files.n > 1 && (querying || index_path)) {
+            fprintf(stderr, "Error: index queries and --index take a single logfile.\n");
+            rc = 1;
+        } else {
+            for (size_t i = 0; i < files.n; i++) {
+                int r = run_index(files.files[i].path, index_path, build, &query);
+                if (r)
+                    rc = r;
+            }
+        }
+    } else if (an.hist.interval > 0 || an.top_n > 0) {
+        // Histogram / template mode replaces the plain counters
+        rc = run_analysis(&an, &files);
     } else {
-        printf("File: %s\n", filename);
-        printf("Lines: %d\nWords: %d\nCharacters: %d\n", lines, words, chars);
-        printf("ERROR entries: %d\nWARNING entries: %d\nINFO entries: %d\n", err, warn, info);
+        if (nthreads <= 0)
+            nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        if (nthreads <= 0)
+            nthreads = 1;
+        rc = run_counts(&files, summary_only, nthreads);
     }
 
-    munmap(map, sb.st_size);
-    close(fd);
-    return 0;
+    if (files.missed && rc == 0)
+        rc = 2;
+    if (io_stats)
+        mf_print_stats(stderr);
+    file_list_free(&files);
+    return rc;
 }
@@ -0,0 +1,404 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <linux/perf_event.h>
+
+// Benchmark helper for loganalyzer:
+//   gen    writes a synthetic log of a given size, line-length distribution and level mix
+//   evict  drops a file from the page cache, for cold-cache runs
+//   run    runs a command and reports wall time, cycles and peak RSS
+
+#define OUT_BUFFER_SIZE (1024 * 1024)
+
+// xorshift64*: fast and good enough for synthetic data
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t rng_next() {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 2685821657736338717ULL;
+}
+
+static double rng_unit() {
+    return (rng_next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static const char *levels[] = { "ERROR", "WARNING", "INFO", "DEBUG" };
+
+// message shapes modelled on sample_log.txt; %d and %x are filled with random values
+static const char *messages[] = {
+    "Application started",
+    "Disk usage above %d%%",
+    "Failed to load configuration from /etc/app/%d.conf",
+    "Connection restored after %d ms",
+    "High memory usage detected: %d MB",
+    "Unexpected shutdown of worker %d",
+    "Service restarted (pid %d)",
+    "Request %x completed in %d ms",
+    "User %d logged in from 10.0.%d.%d",
+    "Delay detected on queue %d",
+    "Cache miss for key 0x%x",
+    "Shutting down",
+};
+
+static const char filler[] =
+    "lorem ipsum dolor sit amet consectetur adipiscing elit sed do eiusmod tempor "
+    "incididunt ut labore et dolore magna aliqua ut enim ad minim veniam quis nostrud ";
+
+// parse sizes like 512, 64K, 16M, 20G
+static int parse_size(const char *s, uint64_t *out) {
+    char *end;
+    errno = 0;
+    double v = strtod(s, &end);
+    if (end == s || errno || v < 0)
+        return -1;
+    switch (*end) {
+        case 'k': case 'K': v *= 1024; end++; break;
+        case 'm': case 'M': v *= 1024 * 1024; end++; break;
+        case 'g': case 'G': v *= 1024.0 * 1024 * 1024; end++; break;
+        default: break;
+    }
+    if (*end != '\0')
+        return -1;
+    *out = (uint64_t)v;
+    return 0;
+}
+
+struct gen_opts {
+    const char *output;
+    uint64_t size;
+    int min_len, max_len;
+    int skewed;         // most lines short with a long tail, instead of uniform
+    int mix[4];         // relative weights of ERROR, WARNING, INFO, DEBUG
+};
+
+static int pick_length(const struct gen_opts *g) {
+    int span = g->max_len - g->min_len;
+    if (span <= 0)
+        return g->min_len;
+    if (!g->skewed)
+        return g->min_len + (int)(rng_next() % (uint64_t)(span + 1));
+
+    // exponential with mean span/4, clipped at max_len
+    double x = -log1p(-rng_unit()) * span / 4.0;
+    return x >= span ? g->max_len : g->min_len + (int)x;
+}
+
+static int pick_level(const struct gen_opts *g) {
+    int total = g->mix[0] + g->mix[1] + g->mix[2] + g->mix[3];
+    int r = (int)(rng_next() % (uint64_t)total);
+    for (int i = 0; i < 3; i++) {
+        if (r < g->mix[i])
+            return i;
+        r -= g->mix[i];
+    }
+    return 3;
+}
+
+// fill buf with one line (including '\n') and return its length
+static int make_line(const struct gen_opts *g, time_t ts, char *buf, int cap) {
+    int target = pick_length(g);
+    if (target >= cap)
+        target = cap - 1;
+
+    struct tm tm;
+    gmtime_r(&ts, &tm);
+    int n = (int)strftime(buf, (size_t)cap, "%Y-%m-%d %H:%M:%S ", &tm);
+    n += snprintf(buf + n, (size_t)(cap - n), "%s ", levels[pick_level(g)]);
+
+    const char *fmt = messages[rng_next() % (sizeof(messages) / sizeof(messages[0]))];
+    n += snprintf(buf + n, (size_t)(cap - n), fmt, (int)(rng_next() % 1000),
+                  (int)(rng_next() % 1000), (int)(rng_next() % 256));
+    if (n > cap - 2)
+        n = cap - 2;
+
+    // pad up to the target length, or cut the message down to it
+    if (n < target - 1) {
+        buf[n++] = ' ';
+        size_t off = rng_next() % (sizeof(filler) - 1);
+        while (n < target - 1) {
+            buf[n++] = filler[off];
+            off = (off + 1) % (sizeof(filler) - 1);
+        }
+    } else if (target > 0 && n > target - 1) {
+        n = target - 1 > 0 ? target - 1 : 0;
+    }
+    buf[n++] = '\n';
+    return n;
+}
+
+static int gen_log(const struct gen_opts *g) {
+    int fd = open(g->output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        perror("Error creating output file");
+        return 1;
+    }
+
+    char *out = malloc(OUT_BUFFER_SIZE);
+    char line[8192];
+    if (!out) {
+        perror("Error allocating buffer");
+        close(fd);
+        return 1;
+    }
+
+    uint64_t written = 0;
+    size_t used = 0;
+    time_t ts = 1735689600;    // 2025-01-01 00:00:00 UTC
+
+    while (written + used < g->size) {
+        int n = make_line(g, ts, line, (int)sizeof(line));
+        uint64_t left = g->size - written - used;
+        if ((uint64_t)n > left)
+            n = (int)left;     // last line is cut to hit the exact size
+        if (used + (size_t)n > OUT_BUFFER_SIZE) {
+            if (write(fd, out, used) != (ssize_t)used) {
+                perror("Error writing output");
+                free(out);
+                close(fd);
+                return 1;
+            }
+            written += used;
+            used = 0;
+        }
+        memcpy(out + used, line, (size_t)n);
+        used += (size_t)n;
+
+        // roughly ten lines per second of log time
+        if (rng_next() % 10 == 0)
+            ts++;
+    }
+
+    if (used && write(fd, out, used) != (ssize_t)used) {
+        perror("Error writing output");
+        free(out);
+        close(fd);
+        return 1;
+    }
+
+    free(out);
+    if (close(fd) == -1) {
+        perror("Error closing output");
+        return 1;
+    }
+    return 0;
+}
+
+// write dirty pages back, then ask the kernel to drop the file's cached pages
+static int evict_file(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        perror("Error opening file");
+        return 1;
+    }
+    fdatasync(fd);
+    int rc = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+    if (rc != 0) {
+        fprintf(stderr, "Error evicting %s: %s\n", path, strerror(rc));
+        return 1;
+    }
+    return 0;
+}
+
+static long perf_open(struct perf_event_attr *attr, pid_t pid) {
+    return syscall(SYS_perf_event_open, attr, pid, -1, -1, 0);
+}
+
+// core clock from /proc/cpuinfo, used to estimate cycles when perf is unavailable
+static double cpu_mhz() {
+    FILE *f = fopen("/proc/cpuinfo", "r");
+    if (!f)
+        return 0;
+    char line[256];
+    double mhz = 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "cpu MHz : %lf", &mhz) == 1)
+            break;
+    }
+    fclose(f);
+    return mhz;
+}
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// run argv with stdout discarded and print one line of key=value measurements
+static int run_measured(char **argv) {
+    int go[2];
+    if (pipe(go) == -1) {
+        perror("pipe");
+        return 1;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork failed");
+        return 1;
+    }
+
+    if (pid == 0) {
+        // wait until the parent has attached the cycle counter
+        char c;
+        close(go[1]);
+        if (read(go[0], &c, 1) != 1)
+            _exit(127);
+        close(go[0]);
+        int null = open("/dev/null", O_WRONLY);
+        if (null != -1) {
+            dup2(null, STDOUT_FILENO);
+            close(null);
+        }
+        execvp(argv[0], argv);
+        perror("exec failed");
+        _exit(127);
+    }
+
+    close(go[0]);
+
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    attr.inherit = 1;
+    attr.exclude_hv = 1;
+    long perf_fd = perf_open(&attr, pid);
+
+    double start = now_seconds();
+    if (write(go[1], "g", 1) != 1)
+        perror("write");
+    close(go[1]);
+
+    int status;
+    struct rusage ru;
+    if (wait4(pid, &status, 0, &ru) == -1) {
+        perror("wait4");
+        return 1;
+    }
+    double elapsed = now_seconds() - start;
+    double cpu = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 +
+                 ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+
+    uint64_t cycles = 0;
+    const char *source = "perf";
+    if (perf_fd < 0 || read((int)perf_fd, &cycles, sizeof(cycles)) != sizeof(cycles)) {
+        cycles = (uint64_t)(cpu * cpu_mhz() * 1e6);
+        source = "est";
+    }
+    if (perf_fd >= 0)
+        close((int)perf_fd);
+
+    printf("elapsed=%.6f cpu=%.6f maxrss_kb=%ld cycles=%llu cycles_src=%s status=%d\n",
+           elapsed, cpu, ru.ru_maxrss, (unsigned long long)cycles, source,
+           WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status));
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
+
+void usage() {
+    printf("Usage: logbench gen -o <file> -s <size> [-l min:max] [-d uniform|skewed]\n");
+    printf("                    [-m E:W:I:D] [-r seed]\n");
+    printf("       logbench evict <file>...\n");
+    printf("       logbench run <command> [args...]\n");
+    printf("  -o file     : output log file\n");
+    printf("  -s size     : total size, with optional K/M/G suffix\n");
+    printf("  -l min:max  : line length range in bytes (default 60:200)\n");
+    printf("  -d dist     : uniform (default) or skewed line lengths\n");
+    printf("  -m E:W:I:D  : relative weights of ERROR/WARNING/INFO/DEBUG (default 5:15:60:20)\n");
+    printf("  -r seed     : random seed (default fixed, so output is reproducible)\n");
+}
+
+static int gen_main(int argc, char *argv[]) {
+    struct gen_opts g = { NULL, 0, 60, 200, 0, { 5, 15, 60, 20 } };
+
+    int opt;
+    while ((opt = getopt(argc, argv, "ho:s:l:d:m:r:")) != -1) {
+        switch (opt) {
+            case 'h':
+                usage();
+                return 0;
+            case 'o':
+                g.output = optarg;
+                break;
+            case 's':
+                if (parse_size(optarg, &g.size) == -1) {
+                    fprintf(stderr, "Error: invalid size %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'l':
+                if (sscanf(optarg, "%d:%d", &g.min_len, &g.max_len) != 2 ||
+                    g.min_len < 1 || g.max_len < g.min_len || g.max_len > 8000) {
+                    fprintf(stderr, "Error: -l expects min:max with 1 <= min <= max <= 8000\n");
+                    return 1;
+                }
+                break;
+            case 'd':
+                if (!strcmp(optarg, "skewed")) {
+                    g.skewed = 1;
+                } else if (strcmp(optarg, "uniform") != 0) {
+                    fprintf(stderr, "Error: -d must be uniform or skewed\n");
+                    return 1;
+                }
+                break;
+            case 'm':
+                if (sscanf(optarg, "%d:%d:%d:%d", &g.mix[0], &g.mix[1], &g.mix[2], &g.mix[3]) != 4 ||
+                    g.mix[0] < 0 || g.mix[1] < 0 || g.mix[2] < 0 || g.mix[3] < 0 ||
+                    g.mix[0] + g.mix[1] + g.mix[2] + g.mix[3] == 0) {
+                    fprintf(stderr, "Error: -m expects four non-negative weights E:W:I:D\n");
+                    return 1;
+                }
+                break;
+            case 'r':
+                rng_state = strtoull(optarg, NULL, 10) * 0x9E3779B97F4A7C15ULL | 1;
+                break;
+            default:
+                usage();
+                return 1;
+        }
+    }
+
+    if (!g.output || g.size == 0) {
+        fprintf(stderr, "Error: gen needs -o <file> and -s <size>\n");
+        usage();
+        return 1;
+    }
+    return gen_log(&g);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        usage();
+        return 1;
+    }
+
+    if (!strcmp(argv[1], "gen"))
+        return gen_main(argc - 1, argv + 1);
+
+    if (!strcmp(argv[1], "evict")) {
+        int rc = 0;
+        for (int i = 2; i < argc; i++)
+            rc |= evict_file(argv[i]);
+        return rc;
+    }
+
+    if (!strcmp(argv[1], "run") && argc > 2)
+        return run_measured(argv + 2);
+
+    usage();
+    return !strcmp(argv[1], "-h") ? 0 : 1;
+}
@@ -0,0 +1,288 @@
+// mappedfile.c - see mappedfile.h. Compiles as C or C++, so the C++ tools
+// can build it in the same g++ command.
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#include "mappedfile.h"
+
+// counters of every closed file; tools may close files on several threads
+static struct mf_stats mf_totals;
+
+static void add_totals(const struct mf_stats *s) {
+    __atomic_fetch_add(&mf_totals.files, s->files, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&mf_totals.map_calls, s->map_calls, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&mf_totals.bytes_mapped, s->bytes_mapped, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&mf_totals.read_calls, s->read_calls, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&mf_totals.bytes_read, s->bytes_read, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&mf_totals.prefetch_calls, s->prefetch_calls, __ATOMIC_RELAXED);
+}
+
+int mf_open(struct mapped_file *mf, const char *path, int flags) {
+    memset(mf, 0, sizeof(*mf));
+    mf->flags = flags;
+
+    if (strcmp(path, "-") == 0) {
+        mf->fd = dup(STDIN_FILENO);
+    } else {
+        mf->fd = open(path, O_RDONLY | O_CLOEXEC);
+    }
+    if (mf->fd == -1)
+        return -1;
+    if (fstat(mf->fd, &mf->st) == -1) {
+        int saved = errno;
+        close(mf->fd);
+        mf->fd = -1;
+        errno = saved;
+        return -1;
+    }
+    if (S_ISDIR(mf->st.st_mode)) {
+        close(mf->fd);
+        mf->fd = -1;
+        errno = EISDIR;
+        return -1;
+    }
+
+    // /proc and sysfs files are regular but report size 0: read them like pipes
+    mf->is_stream = !S_ISREG(mf->st.st_mode) || mf->st.st_size == 0 || (flags & MF_STREAM);
+    if (!mf->is_stream && (flags & MF_SEQUENTIAL))
+        posix_fadvise(mf->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    mf->stats.files = 1;
+    return 0;
+}
+
+// mmap [off, off + len) of a regular file and apply the open flags' hints
+static char *map_region(struct mapped_file *mf, uint64_t off, size_t len) {
+    int mflags = MAP_PRIVATE | ((mf->flags & MF_POPULATE) ? MAP_POPULATE : 0);
+    void *p = mmap(NULL, len, PROT_READ, mflags, mf->fd, (off_t)off);
+    if (p == MAP_FAILED)
+        return NULL;
+    mf->stats.map_calls++;
+    mf->stats.bytes_mapped += len;
+
+    if (mf->flags & MF_SEQUENTIAL)
+        madvise(p, len, MADV_SEQUENTIAL);
+    else if (mf->flags & MF_RANDOM)
+        madvise(p, len, MADV_RANDOM);
+#ifdef MADV_HUGEPAGE
+    if (mf->flags & MF_HUGEPAGE)
+        madvise(p, len, MADV_HUGEPAGE);
+#endif
+    return (char *)p;
+}
+
+// a single read(2), retried on EINTR
+static ssize_t read_some(struct mapped_file *mf, char *dst, size_t cap) {
+    ssize_t n;
+    do {
+        n = read(mf->fd, dst, cap);
+    } while (n == -1 && errno == EINTR);
+    if (n > 0) {
+        mf->stats.read_calls++;
+        mf->stats.bytes_read += (uint64_t)n;
+    }
+    return n;
+}
+
+// read a stream to EOF into one growing buffer
+static int read_all(struct mapped_file *mf) {
+    size_t cap = MF_STREAM_BUF, len = 0;
+    char *buf = (char *)malloc(cap);
+    if (!buf)
+        return -1;
+
+    for (;;) {
+        if (len == cap) {
+            char *nb = (char *)realloc(buf, cap * 2);
+            if (!nb) {
+                free(buf);
+                return -1;
+            }
+            buf = nb;
+            cap *= 2;
+        }
+        ssize_t n = read_some(mf, buf + len, cap - len);
+        if (n == 0)
+            break;
+        if (n == -1) {
+            int saved = errno;
+            free(buf);
+            errno = saved;
+            return -1;
+        }
+        len += (size_t)n;
+    }
+
+    if (len == 0) {
+        free(buf);
+        buf = NULL;
+    }
+    mf->data = buf;
+    mf->len = len;
+    mf->data_is_buf = 1;
+    return 0;
+}
+
+int mf_map_all(struct mapped_file *mf, const char **data, size_t *len) {
+    if (!mf->data && mf->len == 0) {
+        if (mf->is_stream) {
+            if (read_all(mf) == -1)
+                return -1;
+        } else {
+            if ((uint64_t)mf->st.st_size > (uint64_t)SIZE_MAX) {
+                errno = EFBIG;      // use mf_next() to scan it in windows
+                return -1;
+            }
+            mf->len = (size_t)mf->st.st_size;
+            mf->data = map_region(mf, 0, mf->len);
+            if (!mf->data) {
+                mf->len = 0;
+                return -1;
+            }
+        }
+    }
+    *data = mf->data;
+    *len = mf->len;
+    return 0;
+}
+
+// allocate the stream buffer, on huge pages if asked
+static int alloc_stream_buf(struct mapped_file *mf) {
+    void *p = mmap(NULL, MF_STREAM_BUF, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        return -1;
+#ifdef MADV_HUGEPAGE
+    if (mf->flags & MF_HUGEPAGE)
+        madvise(p, MF_STREAM_BUF, MADV_HUGEPAGE);
+#endif
+    mf->buf = (char *)p;
+    mf->buf_cap = MF_STREAM_BUF;
+    return 0;
+}
+
+ssize_t mf_next(struct mapped_file *mf, const char **data) {
+    if (mf->is_stream) {
+        if (!mf->buf && alloc_stream_buf(mf) == -1)
+            return -1;
+
+        // fill the whole buffer so callers see fixed-size blocks until EOF
+        size_t len = 0;
+        while (len < mf->buf_cap) {
+            ssize_t n = read_some(mf, mf->buf + len, mf->buf_cap - len);
+            if (n == 0)
+                break;
+            if (n == -1)
+                return -1;
+            len += (size_t)n;
+        }
+        mf->pos += len;
+        *data = mf->buf;
+        return (ssize_t)len;
+    }
+
+    if (mf->win) {
+        munmap(mf->win, mf->win_len);
+        mf->win = NULL;
+    }
+    uint64_t size = (uint64_t)mf->st.st_size;
+    if (mf->pos >= size)
+        return 0;
+
+    size_t len = size - mf->pos < MF_WINDOW_SIZE ? (size_t)(size - mf->pos) : MF_WINDOW_SIZE;
+    mf->win = map_region(mf, mf->pos, len);
+    if (!mf->win)
+        return -1;
+    mf->win_len = len;
+    mf->pos += len;
+
+    // start reading the next window from disk while the caller scans this one
+    if ((mf->flags & MF_SEQUENTIAL) && mf->pos < size) {
+        posix_fadvise(mf->fd, (off_t)mf->pos, MF_WINDOW_SIZE, POSIX_FADV_WILLNEED);
+        mf->stats.prefetch_calls++;
+    }
+    *data = mf->win;
+    return (ssize_t)len;
+}
+
+void mf_prefetch(struct mapped_file *mf, uint64_t off) {
+    if (mf->data_is_buf || !mf->data)
+        return;
+
+    // keep between one and two MF_PREFETCH steps hinted ahead of the scan
+    uint64_t target = off + 2 * MF_PREFETCH;
+    if (target > mf->len)
+        target = mf->len;
+    while (mf->prefetched < target) {
+        size_t len = mf->len - mf->prefetched < MF_PREFETCH ? (size_t)(mf->len - mf->prefetched)
+                                                            : MF_PREFETCH;
+        madvise(mf->data + mf->prefetched, len, MADV_WILLNEED);
+        mf->prefetched += len;
+        mf->stats.prefetch_calls++;
+    }
+}
+
+void mf_close(struct mapped_file *mf) {
+    if (mf->data) {
+        if (mf->data_is_buf)
+            free(mf->data);
+        else
+            munmap(mf->data, mf->len);
+    }
+    if (mf->win)
+        munmap(mf->win, mf->win_len);
+    if (mf->buf)
+        munmap(mf->buf, mf->buf_cap);
+    if (mf->fd >= 0)
+        close(mf->fd);
+    add_totals(&mf->stats);
+    memset(mf, 0, sizeof(*mf));
+    mf->fd = -1;
+}
+
+void mf_get_totals(struct mf_stats *out) {
+    out->files = __atomic_load_n(&mf_totals.files, __ATOMIC_RELAXED);
+    out->map_calls = __atomic_load_n(&mf_totals.map_calls, __ATOMIC_RELAXED);
+    out->bytes_mapped = __atomic_load_n(&mf_totals.bytes_mapped, __ATOMIC_RELAXED);
+    out->read_calls = __atomic_load_n(&mf_totals.read_calls, __ATOMIC_RELAXED);
+    out->bytes_read = __atomic_load_n(&mf_totals.bytes_read, __ATOMIC_RELAXED);
+    out->prefetch_calls = __atomic_load_n(&mf_totals.prefetch_calls, __ATOMIC_RELAXED);
+}
+
+// bytes as B, KB, MB or GB with one decimal
+static void format_bytes(char *out, size_t cap, uint64_t n) {
+    static const char *units[] = { "B", "KB", "MB", "GB" };
+    double v = (double)n;
+    int u = 0;
+    while (v >= 1000 && u < 3) {
+        v /= 1000;
+        u++;
+    }
+    if (u == 0)
+        snprintf(out, cap, "%llu B", (unsigned long long)n);
+    else
+        snprintf(out, cap, "%.1f %s", v, units[u]);
+}
+
+void mf_print_stats(FILE *out) {
+    struct mf_stats s;
+    mf_get_totals(&s);
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) == -1)
+        memset(&ru, 0, sizeof(ru));
+
+    char mapped[32], read_bytes[32];
+    format_bytes(mapped, sizeof(mapped), s.bytes_mapped);
+    format_bytes(read_bytes, sizeof(read_bytes), s.bytes_read);
+    fprintf(out, "I/O: %llu files, %s mapped in %llu mmap calls, %s in %llu read calls, "
+            "%llu prefetch hints, %ld minor / %ld major page faults\n",
+            (unsigned long long)s.files, mapped, (unsigned long long)s.map_calls, read_bytes,
+            (unsigned long long)s.read_calls, (unsigned long long)s.prefetch_calls,
+            ru.ru_minflt, ru.ru_majflt);
+}
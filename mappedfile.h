@@ -0,0 +1,94 @@
+// mappedfile.h - shared file access for loganalyzer, memview and filecrypt
+//
+// Regular files are read through mmap(2), either whole (mf_map_all) or one
+// window at a time (mf_next), with madvise(2) hints. Pipes, terminals, other
+// non-regular files and files that report a size of 0 (such as /proc files)
+// fall back to read(2) into a large buffer, so every tool handles them the
+// same way. Every open file adds to one set of I/O counters that a tool can
+// print with mf_print_stats().
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// mf_open() flags
+#define MF_SEQUENTIAL  0x01     // MADV_SEQUENTIAL, plus WILLNEED ahead of the scan
+#define MF_RANDOM      0x02     // MADV_RANDOM: no readahead
+#define MF_POPULATE    0x04     // MAP_POPULATE: fault the whole mapping in up front
+#define MF_HUGEPAGE    0x08     // MADV_HUGEPAGE on mappings and the stream buffer
+#define MF_STREAM      0x10     // never mmap; always read(2) into a buffer
+
+#define MF_WINDOW_SIZE (64UL * 1024 * 1024)     // mf_next() mapping window
+#define MF_STREAM_BUF  (4UL * 1024 * 1024)      // mf_next() read buffer
+#define MF_PREFETCH    (16UL * 1024 * 1024)     // distance mf_prefetch() looks ahead
+
+struct mf_stats {
+    uint64_t files;             // files opened
+    uint64_t map_calls;         // mmap(2) calls
+    uint64_t bytes_mapped;      // total length of those mappings
+    uint64_t read_calls;        // read(2) calls on streams
+    uint64_t bytes_read;
+    uint64_t prefetch_calls;    // MADV_WILLNEED / POSIX_FADV_WILLNEED hints
+};
+
+struct mapped_file {
+    int fd;
+    int flags;
+    int is_stream;              // read(2) only; size is not known up front
+    struct stat st;
+
+    // mf_map_all(): the whole file, mapped or (for streams) read into memory
+    char *data;
+    size_t len;
+    int data_is_buf;            // data came from malloc, not mmap
+
+    // mf_next(): the current window or buffer and the offset after it
+    char *win;
+    size_t win_len;
+    uint64_t pos;
+    char *buf;
+    size_t buf_cap;
+
+    uint64_t prefetched;        // end of the range already hinted WILLNEED
+    struct mf_stats stats;      // this file's counters, added to the totals on close
+};
+
+// open path ("-" for standard input); returns -1 with errno set on failure
+int mf_open(struct mapped_file *mf, const char *path, int flags);
+
+// the whole file in *data/*len; an empty file gives NULL and 0.
+// The memory stays valid until mf_close().
+int mf_map_all(struct mapped_file *mf, const char **data, size_t *len);
+
+// next block of a sequential scan: a window of at most MF_WINDOW_SIZE bytes
+// of a regular file, or a full MF_STREAM_BUF read from a stream (shorter only
+// at end of file). Returns the block length, 0 at end of file or -1 on error.
+// The block stays valid until the next call.
+ssize_t mf_next(struct mapped_file *mf, const char **data);
+
+// hint MADV_WILLNEED up to 2 * MF_PREFETCH bytes past offset off of an
+// mf_map_all() mapping; call it as a scan advances, repeated calls are cheap
+void mf_prefetch(struct mapped_file *mf, uint64_t off);
+
+void mf_close(struct mapped_file *mf);
+
+// counters summed over every file closed so far
+void mf_get_totals(struct mf_stats *out);
+
+// one line with the totals and this process's page faults
+void mf_print_stats(FILE *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
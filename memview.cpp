@@ -1,11 +1,10 @@
 #include <iostream>     
 #include <fstream>     
-#include <sys/mman.h>   
 #include <sys/stat.h>   
-#include <fcntl.h>      
 #include <unistd.h>     
 #include <cstdlib>      
 #include <cstdio>       
+#include "mappedfile.h"
 
 using namespace std;
 
@@ -16,14 +15,15 @@ void print_usage(const char* prog) {
 
 // This function prints the contents of the file in a hex + ASCII format
 // It shows memory addresses, raw bytes, and readable characters
-void print_memory_view(const char* data, size_t size) {
+// 'base' is the file offset of data[0], since large files arrive in windows
+void print_memory_view(const char* data, size_t size, unsigned long long base) {
     const int bytesPerLine = 16;  // print 16 bytes per line
 
     // Loop through the entire file in chunks of 16 bytes
     for (size_t i = 0; i < size; i += bytesPerLine) {
 
         // Print the offset (memory address) of the current line
-        printf("%08zx  ", i);
+        printf("%08llx  ", base + i);
 
         // Print each byte in hex format
         for (int j = 0; j < bytesPerLine; j++) {
@@ -96,47 +96,49 @@ int main(int argc, char* argv[]) {
 
     const char* filename = argv[1];  // file to open
 
-    // Try to open the file in read-only mode
-    int fd = open(filename, O_RDONLY);
-    if (fd == -1) {
+    // Open the file read-only; regular files are mapped in windows with mmap(),
+    // pipes and /proc files are read into a buffer instead
+    struct mapped_file mf;
+    if (mf_open(&mf, filename, MF_SEQUENTIAL) == -1) {
         perror("Error opening file");  // print system error message
         return 1;
     }
 
-    // Use fstat() to get details about the file (size, permissions, etc.)
-    struct stat sb;
-    if (fstat(fd, &sb) == -1) {
-        perror("fstat failed");
-        close(fd);
+    // Get the first block; nothing at all means the file is empty
+    const char* data;
+    ssize_t len = mf_next(&mf, &data);
+    if (len == -1) {
+        perror("mmap failed");
+        mf_close(&mf);
         return 1;
     }
-
-    size_t fileSize = sb.st_size;  // get file size in bytes
-
-    // If file is empty, stop the program
-    if (fileSize == 0) {
+    if (len == 0) {
         cerr << "Error: File is empty.\n";
-        close(fd);
+        mf_close(&mf);
         return 1;
     }
 
-    // Map the file into memory so we can read it directly
-    char* map = (char*)mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
-
-    // If mmap failed, handle the error
-    if (map == MAP_FAILED) {
-        perror("mmap failed");
-        close(fd);
-        return 1;
+    // Display file size (unknown up front for a stream) and then the hex dump
+    if (mf.is_stream)
+        cout << "File size: unknown (reading a stream)\n" << endl;
+    else
+        cout << "File size: " << mf.st.st_size << " bytes\n" << endl;
+
+    unsigned long long offset = 0;
+    while (len > 0) {
+        print_memory_view(data, (size_t)len, offset);
+        offset += (unsigned long long)len;
+        len = mf_next(&mf, &data);
     }
-
-    // Display file size and then print a hex dump of the memory region
-    cout << "File size: " << fileSize << " bytes\n" << endl;
-    print_memory_view(map, fileSize);
-
-    // Unmap memory and close file
-    munmap(map, fileSize);
-    close(fd);
+    if (len == -1)
+        perror("Error reading file");
+    if (mf.is_stream)
+        cout << "\nRead " << offset << " bytes" << endl;
+
+    // Unmap memory and close file, then show how the file was read
+    mf_close(&mf);
+    cout << endl;
+    mf_print_stats(stdout);
 
     // Print the process's virtual memory map
     print_virtual_memory_maps();
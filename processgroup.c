@@ -1,16 +1,173 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <unistd.h>
 #include <signal.h>
+#include <errno.h>
 #include <sys/wait.h>
 #include <string.h>
 #include <time.h>
 #include <sys/resource.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <limits.h>
+#include <sched.h>
+#include <dirent.h>
+#include <sys/uio.h>
+#include <linux/perf_event.h>
 
-#define MAX_CHILDREN 20
+#define MAX_CHILDREN 32768
 
-// array holding the PIDs of all children
-int child_pids[MAX_CHILDREN];
+// events handled per epoll_wait call
+#define MAX_EVENTS 256
+
+// default grace period between SIGTERM and SIGKILL at shutdown
+#define DEFAULT_KILL_TIMEOUT_MS 2000
+
+// epoll tokens for the signalfd and sampler timer; child pidfds use their slot index
+#define TOKEN_SIGNAL UINT32_MAX
+#define TOKEN_TIMER  (UINT32_MAX - 1)
+#define TOKEN_RESULTS (UINT32_MAX - 2)
+
+// descriptors a worker finds its own job pipe and the shared result pipe on
+#define JOB_FD    3
+#define RESULT_FD 4
+
+// with --perf a child blocks reading this descriptor until its counters are attached
+#define GATE_FD   5
+
+// fastest sampling interval the sampler accepts
+#define MIN_SAMPLE_MS 10
+
+// a child that ran at least this long before crashing restarts with the minimum backoff
+#define BACKOFF_RESET_MS 10000
+
+// where children are allowed to run
+enum placement { PLACE_NONE, PLACE_COMPACT, PLACE_SPREAD, PLACE_NUMA, PLACE_LIST };
+
+static const char *placement_names[] = { "none", "compact", "spread", "numa", "list" };
+
+// one online CPU as described by /sys/devices/system/cpu
+struct cpu_info {
+    int cpu;
+    int package;
+    int core;
+    int node;
+    int core_rank;          // index of this core within its package
+    int smt_rank;           // index of this hardware thread within its core
+};
+
+// when to restart a child that exited
+enum restart_policy { RESTART_NEVER, RESTART_ON_FAILURE, RESTART_ALWAYS };
+
+// --perf counters. The hardware set is one group led by cycles; when the PMU
+// is unavailable or restricted the software set, led by task-clock, is used.
+enum perf_counter {
+    PC_CYCLES, PC_INSTRUCTIONS, PC_CACHE_REFS, PC_CACHE_MISSES, PC_BRANCHES,
+    PC_BRANCH_MISSES, PC_PAGE_FAULTS, PC_TASK_CLOCK, PC_CONTEXT_SWITCHES, NUM_PERF
+};
+
+#define PERF_SET_HW 1
+#define PERF_SET_SW 2
+
+static const struct {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+    int sets;
+} perf_defs[NUM_PERF] = {
+    { "cycles",           PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES,          PERF_SET_HW },
+    { "instructions",     PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS,        PERF_SET_HW },
+    { "cache-references", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES,    PERF_SET_HW },
+    { "cache-misses",     PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES,        PERF_SET_HW },
+    { "branches",         PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS, PERF_SET_HW },
+    { "branch-misses",    PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES,       PERF_SET_HW },
+    { "page-faults",      PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS,         PERF_SET_HW | PERF_SET_SW },
+    { "task-clock",       PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK,          PERF_SET_SW },
+    { "context-switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES,    PERF_SET_SW },
+};
+
+// one line of the --jobs list
+struct job {
+    char *cmd;              // run with /bin/sh -c
+    int attempts;
+    int status;             // wait status of the last attempt, -1 if it never ran
+    int done;               // succeeded, or failed on every allowed attempt
+    int worker;             // slot of the last attempt
+    double elapsed_ms;      // last attempt, timed by the worker
+    double total_ms;        // all attempts
+};
+
+// what the parent writes to a worker's job pipe, followed by len bytes of command
+struct job_header {
+    int32_t job;
+    uint32_t len;
+};
+
+// what a worker writes to the shared result pipe after each job. Records are
+// far below PIPE_BUF, so writes from different workers never interleave.
+struct job_result {
+    int32_t slot;
+    int32_t job;
+    int32_t status;
+    int32_t pad;
+    double elapsed_ms;
+};
+
+// one reading of a child's /proc files
+struct sample {
+    double t_ms;            // since processgroup started
+    pid_t pid;
+    long rss_kb;
+    double cpu_pct;         // since the previous sample of the same pid
+    unsigned long utime, stime;     // clock ticks
+    unsigned long minflt, majflt;
+    unsigned long vcsw, ivcsw;
+};
+
+// one slot per child; a slot keeps its index across restarts
+struct child {
+    pid_t pid;              // 0 when not running
+    pid_t last_pid;         // most recent pid, kept for the exit report
+    int pidfd;              // -1 if pidfd_open is unavailable (SIGCHLD fallback)
+    int restarts;
+    int backoff_ms;         // delay before the next restart
+    double started;         // monotonic time of the last spawn
+    double restart_at;      // > 0 while a restart is pending
+
+    // /proc/<pid> files kept open and re-read with pread by the sampler
+    int stat_fd, statm_fd, status_fd;
+    struct sample *ring;    // last ring_size samples of the current pid
+    size_t ring_head, ring_count;
+    long peak_rss_kb;       // over every sample of the slot, across restarts
+    double max_cpu_pct;
+    struct sample last;     // most recent sample of the current pid
+    int have_last;
+    long final_rss_kb;      // RSS read just before shutdown, -1 if unknown
+
+    // placement and scheduling counters
+    int cpu;                // pinned CPU, or -1 (NUMA placement uses node)
+    int node;               // pinned NUMA node, or -1
+    long migrations;        // se.nr_migrations of each exited pid, summed; -1 if unknown
+    long nvcsw, nivcsw;     // from wait4(), summed over restarts of this slot
+
+    // --perf counter group of the current pid, and totals over its restarts
+    int perf_fd[NUM_PERF];
+    uint64_t perf_count[NUM_PERF];
+
+    // job queue mode
+    int job_fd;             // write end of this worker's job pipe, -1 if closed
+    int job;                // job in flight, or -1 when idle
+    double job_sent;        // when that job was handed over
+};
+
+// table of all children, sized by -n
+struct child *children = NULL;
 
 // default number of children unless -n is run
 int num_children = 5;
@@ -19,36 +176,358 @@ int num_children = 5;
 int quiet_mode = 0;      // Suppress child output
 int random_mode = 0;     // Each child sleeps random time (1-3 seconds)
 
-// flag modified by SIGINT handler to trigger cleanup
-volatile sig_atomic_t stop_flag = 0;
+// restart policy and exponential backoff bounds
+enum restart_policy restart_policy = RESTART_ON_FAILURE;
+int backoff_min_ms = 100;
+int backoff_max_ms = 5000;
+
+// placement policy and scheduling options
+enum placement placement = PLACE_NONE;
+struct cpu_info *cpus = NULL;   // in placement order for compact/spread/list
+int num_cpus = 0;
+int num_nodes = 1;
+int child_nice = 0;
+int use_nice = 0;
+int use_batch = 0;              // SCHED_BATCH
+
+// job queue (--jobs); pending jobs wait in a ring of job indices
+struct job *jobs = NULL;
+int num_jobs = 0;
+int *job_queue = NULL;
+int queue_head = 0, queue_len = 0;
+int jobs_done = 0;
+int job_retries = 1;
+int result_rd = -1, result_wr = -1;
+double jobs_start = 0, jobs_end = 0;
+
+// --perf state; the counter set drops to software if the first hardware group fails
+int perf_mode = 0;
+int perf_set = PERF_SET_HW;
+int perf_hw_opened = 0;             // a hardware group has opened, so the PMU works
+int perf_exclude_kernel = 0;        // set when perf_event_paranoid refuses kernel counting
+int perf_opened[NUM_PERF];          // counters that opened for at least one child
+int perf_multiplexed = 0;           // some counter ran for less time than it was enabled
 
-// sets the stop_flag so the main loop knows it's time to shut down.
-void sigint_handler(int sig) {
-    (void)sig;
-    stop_flag = 1;
-    write(STDOUT_FILENO, "\n[processgroup] SIGINT caught — cleaning up...\n", 47);
+// live resource sampler; interval 0 = disabled
+int sample_interval_ms = 0;
+size_t ring_size = 1024;
+const char *csv_path = NULL;
+FILE *csv_file = NULL;
+double start_ms = 0;
+
+// event loop state
+int epoll_fd = -1;
+int signal_fd = -1;
+int timer_fd = -1;
+int stopping = 0;        // set once SIGINT/SIGTERM arrives
+int live_children = 0;
+
+// children run in their own process group so shutdown is one killpg()
+pid_t group_id = 0;
+char exe_path[PATH_MAX];
+extern char **environ;
+
+// shutdown escalation and latency reporting
+int kill_timeout_ms = DEFAULT_KILL_TIMEOUT_MS;
+double kill_deadline = 0;   // when SIGKILL follows SIGTERM; 0 once sent
+double teardown_start = 0;
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+void schedule_restart(int i, int failed);
+
+static int pidfd_open(pid_t pid) {
+    return (int)syscall(SYS_pidfd_open, pid, 0);
 }
 
-// print per child mem usage
-void print_child_memory(pid_t pid) {
+// VmRSS of a running process in kB, or -1 if it is gone
+long read_vmrss(pid_t pid) {
     char path[64];
     snprintf(path, sizeof(path), "/proc/%d/status", pid);
 
     FILE *f = fopen(path, "r");
-    if (!f) {
-        printf("PID %d: (terminated before reading memory)\n", pid);
-        return;
-    }
+    if (!f)
+        return -1;
 
     char line[256];
+    long kb = -1;
     while (fgets(line, sizeof(line), f)) {
         if (strncmp(line, "VmRSS:", 6) == 0) {
-            printf("PID %d Memory (RSS): %s", pid, line + 6);
+            kb = atol(line + 6);
             break;
         }
     }
 
     fclose(f);
+    return kb;
+}
+
+// print per child mem usage, as read just before shutdown
+void print_child_memory(int i) {
+    struct child *c = &children[i];
+    if (c->final_rss_kb < 0) {
+        printf("PID %d: (terminated before reading memory)\n", c->last_pid);
+        return;
+    }
+    printf("PID %d Memory (RSS): %ld kB\n", c->last_pid, c->final_rss_kb);
+}
+
+static int open_proc_file(pid_t pid, const char *name) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/%s", pid, name);
+    return open(path, O_RDONLY | O_CLOEXEC);
+}
+
+// open the /proc files of a freshly spawned child once
+void sampler_attach(struct child *c) {
+    c->stat_fd = open_proc_file(c->pid, "stat");
+    c->statm_fd = open_proc_file(c->pid, "statm");
+    c->status_fd = open_proc_file(c->pid, "status");
+    c->have_last = 0;
+    c->ring_head = c->ring_count = 0;   // a new pid: the window restarts, the peaks do not
+}
+
+void sampler_detach(struct child *c) {
+    if (c->stat_fd >= 0) close(c->stat_fd);
+    if (c->statm_fd >= 0) close(c->statm_fd);
+    if (c->status_fd >= 0) close(c->status_fd);
+    c->stat_fd = c->statm_fd = c->status_fd = -1;
+}
+
+static ssize_t pread_text(int fd, char *buf, size_t cap) {
+    if (fd < 0)
+        return -1;
+    ssize_t n = pread(fd, buf, cap - 1, 0);
+    if (n >= 0)
+        buf[n] = '\0';
+    return n;
+}
+
+static unsigned long status_field(const char *buf, const char *key) {
+    const char *p = strstr(buf, key);
+    return p ? strtoul(p + strlen(key), NULL, 10) : 0;
+}
+
+// take one sample of slot i; returns -1 if the child is already gone
+int sample_child(int i, double now) {
+    struct child *c = &children[i];
+    char buf[2048];
+    struct sample s;
+    memset(&s, 0, sizeof(s));
+    s.t_ms = now - start_ms;
+    s.pid = c->pid;
+
+    // /proc/<pid>/stat: fields after the ")" of the command name
+    if (pread_text(c->stat_fd, buf, sizeof(buf)) <= 0)
+        return -1;
+    const char *p = strrchr(buf, ')');
+    if (!p || sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %lu %*u %lu %*u %lu %lu",
+                     &s.minflt, &s.majflt, &s.utime, &s.stime) != 4)
+        return -1;
+
+    long pages = 0;
+    if (pread_text(c->statm_fd, buf, sizeof(buf)) > 0)
+        sscanf(buf, "%*s %ld", &pages);
+    s.rss_kb = pages * (sysconf(_SC_PAGESIZE) / 1024);
+
+    if (pread_text(c->status_fd, buf, sizeof(buf)) > 0) {
+        s.vcsw = status_field(buf, "\nvoluntary_ctxt_switches:");
+        s.ivcsw = status_field(buf, "\nnonvoluntary_ctxt_switches:");
+    }
+
+    if (c->have_last && s.t_ms > c->last.t_ms) {
+        double ticks = (double)(s.utime + s.stime) - (double)(c->last.utime + c->last.stime);
+        s.cpu_pct = 100.0 * ticks / sysconf(_SC_CLK_TCK) / ((s.t_ms - c->last.t_ms) / 1000.0);
+    }
+    c->last = s;
+    c->have_last = 1;
+    if (s.rss_kb > c->peak_rss_kb)
+        c->peak_rss_kb = s.rss_kb;
+    if (s.cpu_pct > c->max_cpu_pct)
+        c->max_cpu_pct = s.cpu_pct;
+
+    c->ring[c->ring_head] = s;
+    c->ring_head = (c->ring_head + 1) % ring_size;
+    if (c->ring_count < ring_size)
+        c->ring_count++;
+
+    if (csv_file)
+        fprintf(csv_file, "%.1f,%d,%d,%ld,%.1f,%lu,%lu,%lu,%lu\n", s.t_ms, i, s.pid, s.rss_kb,
+                s.cpu_pct, s.minflt, s.majflt, s.vcsw, s.ivcsw);
+    return 0;
+}
+
+void sample_all() {
+    uint64_t expirations;
+    if (read(timer_fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+        return;
+
+    double now = now_ms();
+    for (int i = 0; i < num_children; i++)
+        if (children[i].pid > 0)
+            sample_child(i, now);
+}
+
+// start the periodic sampler timer and the CSV file
+int sampler_start() {
+    for (int i = 0; i < num_children; i++) {
+        children[i].ring = calloc(ring_size, sizeof(struct sample));
+        if (!children[i].ring) {
+            perror("calloc");
+            return -1;
+        }
+    }
+
+    if (csv_path) {
+        csv_file = fopen(csv_path, "we");
+        if (!csv_file) {
+            perror("Error opening CSV file");
+            return -1;
+        }
+        fprintf(csv_file, "time_ms,slot,pid,rss_kb,cpu_pct,minflt,majflt,vcsw,ivcsw\n");
+    }
+
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd == -1) {
+        perror("timerfd_create");
+        return -1;
+    }
+    struct itimerspec its;
+    its.it_interval.tv_sec = sample_interval_ms / 1000;
+    its.it_interval.tv_nsec = (sample_interval_ms % 1000) * 1000000L;
+    its.it_value = its.it_interval;
+    struct epoll_event ev = { .events = EPOLLIN, .data.u32 = TOKEN_TIMER };
+    if (timerfd_settime(timer_fd, 0, &its, NULL) == -1 ||
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &ev) == -1) {
+        perror("timerfd_settime");
+        return -1;
+    }
+    return 0;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// nearest-rank percentile of a sorted array
+static double percentile(const double *v, size_t n, double pct) {
+    size_t rank = (size_t)(pct / 100.0 * n + 0.999999);
+    if (rank == 0)
+        rank = 1;
+    return v[(rank > n ? n : rank) - 1];
+}
+
+// running peaks of each slot, and percentiles over the samples its current pid
+// still has in the ring
+void print_sampler_summary() {
+    double *rss = malloc(ring_size * sizeof(double));
+    double *cpu = malloc(ring_size * sizeof(double));
+    if (!rss || !cpu) {
+        free(rss);
+        free(cpu);
+        return;
+    }
+
+    printf("=== Per-Child Samples (every %d ms, up to %zu kept per child) ===\n",
+           sample_interval_ms, ring_size);
+    printf("RSS peak and CPU max: whole run of the slot, across restarts. Samples, p50-p99\n"
+           "and CPU avg: the window of samples kept for PID. Faults and CS: PID only.\n");
+    printf("%4s %7s %9s %9s %7s %9s %9s %9s %7s %7s %8s %6s %7s %7s\n", "Slot", "PID",
+           "RSS peak", "CPU max", "Samples", "RSS p50", "RSS p95", "RSS p99", "CPU avg", "CPU p95",
+           "MinFlt", "MajFlt", "VCSW", "IVCSW");
+
+    for (int i = 0; i < num_children; i++) {
+        struct child *c = &children[i];
+        if (c->ring_count == 0 && c->peak_rss_kb == 0) {
+            printf("%4d %7d  (no samples)\n", i, c->last_pid);
+            continue;
+        }
+        if (c->ring_count == 0) {
+            printf("%4d %7d %6ld kB %8.1f%%  (no samples of this PID)\n", i, c->last_pid,
+                   c->peak_rss_kb, c->max_cpu_pct);
+            continue;
+        }
+
+        double cpu_sum = 0;
+        for (size_t k = 0; k < c->ring_count; k++) {
+            rss[k] = c->ring[k].rss_kb;
+            cpu[k] = c->ring[k].cpu_pct;
+            cpu_sum += cpu[k];
+        }
+        qsort(rss, c->ring_count, sizeof(double), cmp_double);
+        qsort(cpu, c->ring_count, sizeof(double), cmp_double);
+
+        size_t n = c->ring_count;
+        struct sample *l = &c->last;
+        printf("%4d %7d %6ld kB %8.1f%% %7zu %6.0f kB %6.0f kB %6.0f kB %6.1f%% %6.1f%% %8lu %6lu %7lu %7lu\n",
+               i, c->last_pid, c->peak_rss_kb, c->max_cpu_pct, n, percentile(rss, n, 50),
+               percentile(rss, n, 95), percentile(rss, n, 99), cpu_sum / n, percentile(cpu, n, 95),
+               l->minflt, l->majflt, l->vcsw, l->ivcsw);
+    }
+    printf("==========================================\n\n");
+
+    free(rss);
+    free(cpu);
+}
+
+static void format_status(char *buf, size_t len, int status) {
+    if (status == -1)
+        snprintf(buf, len, "not run");
+    else if (WIFSIGNALED(status))
+        snprintf(buf, len, "signal %d", WTERMSIG(status));
+    else if (WEXITSTATUS(status) == 0)
+        snprintf(buf, len, "ok");
+    else
+        snprintf(buf, len, "exit %d", WEXITSTATUS(status));
+}
+
+// per-job outcome and timing, then makespan and worker utilization; returns
+// the number of jobs that did not succeed
+int print_job_report() {
+    int ok = 0, failed = 0, not_run = 0, retries = 0, ran = 0;
+    double busy = 0;
+    double *times = malloc((size_t)(num_jobs ? num_jobs : 1) * sizeof(double));
+
+    printf("\n=== Job Report ===\n");
+    printf("%5s %6s %8s %9s %11s  %s\n", "Job", "Worker", "Attempts", "Status", "Time (ms)", "Command");
+    for (int j = 0; j < num_jobs; j++) {
+        struct job *job = &jobs[j];
+        char st[32];
+        format_status(st, sizeof(st), job->status);
+        printf("%5d %6d %8d %9s %11.1f  %s\n", j, job->worker, job->attempts, st,
+               job->elapsed_ms, job->cmd);
+
+        if (job->status == -1)
+            not_run++;
+        else if (WIFEXITED(job->status) && WEXITSTATUS(job->status) == 0)
+            ok++;
+        else
+            failed++;
+        if (job->attempts > 1)
+            retries += job->attempts - 1;
+        busy += job->total_ms;
+        if (times && job->attempts > 0)
+            times[ran++] = job->elapsed_ms;
+    }
+
+    printf("Jobs: %d ok, %d failed, %d not run, %d retries\n", ok, failed, not_run, retries);
+    if (times && ran > 0) {
+        qsort(times, (size_t)ran, sizeof(double), cmp_double);
+        printf("Job time (ms): min %.1f  p50 %.1f  p95 %.1f  max %.1f\n", times[0],
+               percentile(times, (size_t)ran, 50), percentile(times, (size_t)ran, 95), times[ran - 1]);
+    }
+    double makespan = jobs_end > jobs_start ? jobs_end - jobs_start : 0;
+    printf("Makespan: %.1f ms  Busy: %.1f ms  Utilization: %.1f%% of %d workers\n", makespan, busy,
+           makespan > 0 ? 100.0 * busy / (makespan * num_children) : 0.0, num_children);
+    printf("==========================================\n");
+
+    free(times);
+    return failed + not_run;
 }
 
 //prints total resource usage
@@ -76,54 +555,1053 @@ void print_total_resource_usage() {
     printf("==========================================\n\n");
 }
 
-// creates 'count' child processes using fork()
-void spawn_children(int count) {
-    for (int i = 0; i < count; i++) {
+static double ratio(uint64_t a, uint64_t b) {
+    return b ? (double)a / (double)b : 0.0;
+}
+
+// print one counter column, or "-" if it never opened
+static void perf_column(int k, uint64_t v, int width) {
+    if (perf_opened[k])
+        printf(" %*llu", width, (unsigned long long)v);
+    else
+        printf(" %*s", width, "-");
+}
+
+static void perf_row(const char *slot, pid_t pid, const uint64_t *v) {
+    if (pid > 0)
+        printf("%5s %8d", slot, pid);
+    else
+        printf("%5s %8s", slot, "");
+    if (perf_set == PERF_SET_HW) {
+        perf_column(PC_CYCLES, v[PC_CYCLES], 14);
+        perf_column(PC_INSTRUCTIONS, v[PC_INSTRUCTIONS], 14);
+        printf(" %5.2f", ratio(v[PC_INSTRUCTIONS], v[PC_CYCLES]));
+        perf_column(PC_CACHE_MISSES, v[PC_CACHE_MISSES], 11);
+        printf(" %6.2f%%", 100.0 * ratio(v[PC_CACHE_MISSES], v[PC_CACHE_REFS]));
+        perf_column(PC_BRANCH_MISSES, v[PC_BRANCH_MISSES], 11);
+        printf(" %6.2f%%", 100.0 * ratio(v[PC_BRANCH_MISSES], v[PC_BRANCHES]));
+        perf_column(PC_PAGE_FAULTS, v[PC_PAGE_FAULTS], 9);
+    } else {
+        printf(" %14.1f", v[PC_TASK_CLOCK] / 1e6);
+        perf_column(PC_PAGE_FAULTS, v[PC_PAGE_FAULTS], 11);
+        perf_column(PC_CONTEXT_SWITCHES, v[PC_CONTEXT_SWITCHES], 11);
+    }
+    printf("\n");
+}
+
+// per-child and aggregate counter report from --perf
+void print_perf_report() {
+    uint64_t total[NUM_PERF] = {0};
+
+    printf("=== Per-Child perf Counters (%s events%s) ===\n",
+           perf_set == PERF_SET_HW ? "hardware" : "software",
+           perf_exclude_kernel ? ", user space only" : "");
+    if (perf_set == PERF_SET_HW)
+        printf("%5s %8s %14s %14s %5s %11s %7s %11s %7s %9s\n", "Slot", "PID", "Cycles",
+               "Instructions", "IPC", "Cache miss", "Miss%", "Br miss", "BrMiss%", "PageFlt");
+    else
+        printf("%5s %8s %14s %11s %11s\n", "Slot", "PID", "Task clock ms", "PageFlt", "Ctx sw");
+
+    for (int i = 0; i < num_children; i++) {
+        char slot[16];
+        snprintf(slot, sizeof(slot), "%d", i);
+        perf_row(slot, children[i].last_pid, children[i].perf_count);
+        for (int k = 0; k < NUM_PERF; k++)
+            total[k] += children[i].perf_count[k];
+    }
+    perf_row("Total", 0, total);
+
+    if (perf_multiplexed)
+        printf("(counts scaled: more events than hardware counters, so groups were time-multiplexed)\n");
+    printf("==========================================\n\n");
+}
+
+static int read_sys_int(const char *fmt, int cpu, int fallback) {
+    char path[128];
+    snprintf(path, sizeof(path), fmt, cpu);
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return fallback;
+    int v;
+    if (fscanf(f, "%d", &v) != 1)
+        v = fallback;
+    fclose(f);
+    return v;
+}
+
+// parse a CPU list such as "0,2,4-7" into a malloc'd array
+int parse_cpu_list(const char *s, int **out) {
+    int *list = NULL, n = 0, cap = 0;
+    while (*s) {
+        char *end;
+        long a = strtol(s, &end, 10), b = a;
+        if (end == s || a < 0)
+            goto bad;
+        if (*end == '-') {
+            s = end + 1;
+            b = strtol(s, &end, 10);
+            if (end == s || b < a)
+                goto bad;
+        }
+        for (long c = a; c <= b; c++) {
+            if (n == cap) {
+                cap = cap ? cap * 2 : 16;
+                int *nl = realloc(list, cap * sizeof(*nl));
+                if (!nl)
+                    goto bad;
+                list = nl;
+            }
+            list[n++] = (int)c;
+        }
+        s = end;
+        if (*s == ',')
+            s++;
+        else if (*s)
+            goto bad;
+    }
+    *out = list;
+    return n;
+bad:
+    free(list);
+    return -1;
+}
+
+static int cmp_compact(const void *a, const void *b) {
+    const struct cpu_info *x = a, *y = b;
+    if (x->package != y->package) return x->package - y->package;
+    if (x->core_rank != y->core_rank) return x->core_rank - y->core_rank;
+    return x->smt_rank - y->smt_rank;
+}
+
+// one thread per core and one core per package before doubling up
+static int cmp_spread(const void *a, const void *b) {
+    const struct cpu_info *x = a, *y = b;
+    if (x->smt_rank != y->smt_rank) return x->smt_rank - y->smt_rank;
+    if (x->core_rank != y->core_rank) return x->core_rank - y->core_rank;
+    if (x->package != y->package) return x->package - y->package;
+    return x->cpu - y->cpu;
+}
+
+// read the online CPUs' package, core and NUMA node from sysfs
+int load_topology() {
+    char buf[4096] = "0";
+    FILE *f = fopen("/sys/devices/system/cpu/online", "r");
+    if (f) {
+        if (!fgets(buf, sizeof(buf), f))
+            strcpy(buf, "0");
+        fclose(f);
+    }
+    buf[strcspn(buf, "\n")] = '\0';
+
+    int *online;
+    int n = parse_cpu_list(buf, &online);
+    if (n <= 0)
+        return -1;
+
+    cpus = calloc((size_t)n, sizeof(*cpus));
+    if (!cpus) {
+        free(online);
+        return -1;
+    }
+    num_cpus = n;
+
+    for (int i = 0; i < n; i++) {
+        struct cpu_info *c = &cpus[i];
+        c->cpu = online[i];
+        c->package = read_sys_int("/sys/devices/system/cpu/cpu%d/topology/physical_package_id", c->cpu, 0);
+        c->core = read_sys_int("/sys/devices/system/cpu/cpu%d/topology/core_id", c->cpu, c->cpu);
+
+        // the node shows up as a cpuN/nodeM link
+        char path[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", c->cpu);
+        DIR *d = opendir(path);
+        struct dirent *de;
+        while (d && (de = readdir(d)))
+            if (sscanf(de->d_name, "node%d", &c->node) == 1)
+                break;
+        if (d)
+            closedir(d);
+        if (c->node + 1 > num_nodes)
+            num_nodes = c->node + 1;
+    }
+    free(online);
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            if (cpus[j].package != cpus[i].package)
+                continue;
+            if (cpus[j].core == cpus[i].core && cpus[j].cpu < cpus[i].cpu)
+                cpus[i].smt_rank++;
+            // count distinct lower core ids via the first thread of each core
+            if (cpus[j].core < cpus[i].core) {
+                int first = 1;
+                for (int k = 0; k < j; k++)
+                    if (cpus[k].package == cpus[j].package && cpus[k].core == cpus[j].core)
+                        first = 0;
+                cpus[i].core_rank += first;
+            }
+        }
+    }
+    return 0;
+}
+
+// order the CPU table for the chosen policy; a list replaces it outright
+int setup_placement(const char *cpu_list) {
+    if (placement == PLACE_NONE)
+        return 0;
+    if (load_topology() == -1) {
+        fprintf(stderr, "Error: could not read CPU topology\n");
+        return -1;
+    }
+
+    if (placement == PLACE_COMPACT)
+        qsort(cpus, num_cpus, sizeof(*cpus), cmp_compact);
+    else if (placement == PLACE_SPREAD)
+        qsort(cpus, num_cpus, sizeof(*cpus), cmp_spread);
+    else if (placement == PLACE_LIST) {
+        int *list;
+        int n = parse_cpu_list(cpu_list, &list);
+        if (n <= 0) {
+            fprintf(stderr, "Error: invalid CPU list %s\n", cpu_list);
+            return -1;
+        }
+        free(cpus);
+        cpus = calloc((size_t)n, sizeof(*cpus));
+        if (!cpus) {
+            free(list);
+            return -1;
+        }
+        for (int i = 0; i < n; i++)
+            cpus[i].cpu = list[i];
+        num_cpus = n;
+        free(list);
+    }
+    return 0;
+}
+
+// pin a freshly spawned child and apply nice/SCHED_BATCH while it waits at the gate
+void apply_placement(int i) {
+    struct child *c = &children[i];
+    c->cpu = c->node = -1;
+
+    if (placement != PLACE_NONE) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (placement == PLACE_NUMA) {
+            c->node = i % num_nodes;
+            for (int k = 0; k < num_cpus; k++)
+                if (cpus[k].node == c->node)
+                    CPU_SET(cpus[k].cpu, &set);
+        } else {
+            c->cpu = cpus[i % num_cpus].cpu;
+            CPU_SET(c->cpu, &set);
+        }
+        if (sched_setaffinity(c->pid, sizeof(set), &set) == -1)
+            fprintf(stderr, "[processgroup] sched_setaffinity for child %d: %s\n", i, strerror(errno));
+    }
+
+    if (use_batch) {
+        struct sched_param sp = { .sched_priority = 0 };
+        if (sched_setscheduler(c->pid, SCHED_BATCH, &sp) == -1)
+            fprintf(stderr, "[processgroup] SCHED_BATCH for child %d: %s\n", i, strerror(errno));
+    }
+    if (use_nice && setpriority(PRIO_PROCESS, c->pid, child_nice) == -1)
+        fprintf(stderr, "[processgroup] setpriority for child %d: %s\n", i, strerror(errno));
+}
+
+// se.nr_migrations from /proc/<pid>/sched, or -1 without CONFIG_SCHED_DEBUG
+long read_migrations(pid_t pid) {
+    char path[64], line[256];
+    snprintf(path, sizeof(path), "/proc/%d/sched", pid);
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return -1;
+    long n = -1;
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "se.nr_migrations", 16) == 0) {
+            const char *colon = strchr(line, ':');
+            if (colon)
+                n = atol(colon + 1);
+            break;
+        }
+    }
+    fclose(f);
+    return n;
+}
+
+// per-child placement, migrations and context switches next to the rusage totals
+void print_placement_report() {
+    long total_mig = 0, total_vcsw = 0, total_ivcsw = 0;
+    int mig_known = 0;
+
+    printf("=== Per-Child Placement (policy %s%s%s) ===\n", placement_names[placement],
+           use_batch ? ", SCHED_BATCH" : "", use_nice ? ", niced" : "");
+    printf("%5s %8s %8s %11s %10s %10s\n", "Slot", "PID", "CPUs", "Migrations", "Vol CS", "Invol CS");
+
+    for (int i = 0; i < num_children; i++) {
+        struct child *c = &children[i];
+        char where[16] = "any";
+        if (c->cpu >= 0)
+            snprintf(where, sizeof(where), "%d", c->cpu);
+        else if (c->node >= 0)
+            snprintf(where, sizeof(where), "node%d", c->node);
+
+        if (c->migrations >= 0) {
+            printf("%5d %8d %8s %11ld %10ld %10ld\n", i, c->last_pid, where, c->migrations,
+                   c->nvcsw, c->nivcsw);
+            total_mig += c->migrations;
+            mig_known = 1;
+        } else {
+            printf("%5d %8d %8s %11s %10ld %10ld\n", i, c->last_pid, where, "-", c->nvcsw, c->nivcsw);
+        }
+        total_vcsw += c->nvcsw;
+        total_ivcsw += c->nivcsw;
+    }
+
+    if (mig_known)
+        printf("%5s %8s %8s %11ld %10ld %10ld\n", "Total", "", "", total_mig, total_vcsw, total_ivcsw);
+    else
+        printf("%5s %8s %8s %11s %10ld %10ld\n", "Total", "", "", "-", total_vcsw, total_ivcsw);
+    printf("==========================================\n\n");
+}
+
+// body of every child: loops until the parent kills it with SIGTERM.
+// Children are exec'd as "processgroup --child <slot>", so nothing is inherited
+// from the parent's address space.
+void child_main(int i) {
+    // the parent owns shutdown; children only react to SIGTERM
+    signal(SIGINT, SIG_IGN);
+
+    if (!quiet_mode)
+        printf("[Child %d] Started (PID=%d)\n", i, getpid());
+
+    // if random mode is enabled, children run at different speeds
+    srand(time(NULL) ^ getpid());
+    int delay = random_mode ? (rand() % 3) + 1 : 1;
+
+    while (1) {
+        if (!quiet_mode)
+            printf("[Child %d] Running...\n", i);
+        sleep(delay);
+    }
+    exit(0);
+}
+
+static long perf_event_open(struct perf_event_attr *attr, pid_t pid, int group_fd) {
+    return syscall(SYS_perf_event_open, attr, pid, -1, group_fd, PERF_FLAG_FD_CLOEXEC);
+}
+
+// open the counters of one set as a group on slot i's pid; returns -1 if the
+// group leader cannot be opened
+static int perf_open_group(struct child *c, int set) {
+    int leader = -1;
+
+    for (int k = 0; k < NUM_PERF; k++) {
+        c->perf_fd[k] = -1;
+        if (!(perf_defs[k].sets & set))
+            continue;
+
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = perf_defs[k].type;
+        attr.config = perf_defs[k].config;
+        attr.inherit = 1;           // jobs and other descendants count toward the child
+        attr.exclude_hv = 1;
+        attr.exclude_kernel = perf_exclude_kernel;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        long fd = perf_event_open(&attr, c->pid, leader);
+        if (fd < 0 && errno == EACCES && !perf_exclude_kernel) {
+            // perf_event_paranoid >= 2 only allows user-space counting
+            perf_exclude_kernel = 1;
+            attr.exclude_kernel = 1;
+            fd = perf_event_open(&attr, c->pid, leader);
+        }
+        if (fd < 0) {
+            if (leader == -1)
+                return -1;
+            continue;               // a missing member is reported as "-"
+        }
+        c->perf_fd[k] = (int)fd;
+        perf_opened[k] = 1;
+        if (leader == -1)
+            leader = (int)fd;
+    }
+    return 0;
+}
 
-        pid_t pid = fork();
+// attach the counter group to a freshly spawned child
+void perf_attach(int i) {
+    struct child *c = &children[i];
+    if (perf_open_group(c, perf_set) == 0) {
+        if (perf_set == PERF_SET_HW)
+            perf_hw_opened = 1;
+        return;
+    }
 
-        if (pid < 0) {
-            // fork failed
-            perror("fork failed");
+    // only errors meaning "no usable PMU" switch every child to software
+    // events; anything else (EMFILE, ESRCH, ...) is this child's problem
+    if (perf_set == PERF_SET_HW && !perf_hw_opened &&
+        (errno == ENOENT || errno == EOPNOTSUPP || errno == EACCES)) {
+        fprintf(stderr, "[processgroup] Hardware perf counters unavailable (%s); "
+                "using software events\n", strerror(errno));
+        perf_set = PERF_SET_SW;
+        if (perf_open_group(c, perf_set) == 0)
+            return;
+    }
+    fprintf(stderr, "[processgroup] perf_event_open for child %d: %s\n", i, strerror(errno));
+}
+
+// add the final counts of an exited child to its slot, scaled for multiplexing
+void perf_collect(struct child *c) {
+    for (int k = 0; k < NUM_PERF; k++) {
+        if (c->perf_fd[k] < 0)
+            continue;
+        uint64_t v[3];      // value, time enabled, time running
+        if (read(c->perf_fd[k], v, sizeof(v)) == sizeof(v) && v[2] > 0) {
+            if (v[2] < v[1]) {
+                v[0] = (uint64_t)((double)v[0] * v[1] / v[2]);
+                perf_multiplexed = 1;
+            }
+            c->perf_count[k] += v[0];
+        }
+        close(c->perf_fd[k]);
+        c->perf_fd[k] = -1;
+    }
+}
+
+static ssize_t read_full(int fd, void *buf, size_t len) {
+    size_t got = 0;
+    while (got < len) {
+        ssize_t n = read(fd, (char *)buf + got, len - got);
+        if (n == 0)
+            break;
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        got += (size_t)n;
+    }
+    return (ssize_t)got;
+}
+
+// body of a job queue worker: run each command read from JOB_FD with
+// /bin/sh -c and report its status and time on RESULT_FD. The parent
+// closes the job pipe when every job is done, which ends the loop.
+void worker_main(int i) {
+    signal(SIGINT, SIG_IGN);
+
+    // jobs get default SIGINT and SIGPIPE dispositions, not the worker's
+    posix_spawnattr_t attr;
+    sigset_t defaults;
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGINT);
+    sigaddset(&defaults, SIGPIPE);
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGDEF);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    if (quiet_mode)
+        posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+
+    struct job_header h;
+    while (read_full(JOB_FD, &h, sizeof(h)) == sizeof(h)) {
+        char *cmd = malloc((size_t)h.len + 1);
+        if (!cmd || read_full(JOB_FD, cmd, h.len) != (ssize_t)h.len)
+            exit(1);
+        cmd[h.len] = '\0';
+        if (!quiet_mode)
+            printf("[Worker %d] Job %d: %s\n", i, h.job, cmd);
+        fflush(stdout);
+
+        char *args[] = { "sh", "-c", cmd, NULL };
+        double t0 = now_ms();
+        pid_t pid;
+        int status = 127 << 8;
+        if (posix_spawn(&pid, "/bin/sh", &actions, &attr, args, environ) == 0)
+            while (waitpid(pid, &status, 0) == -1 && errno == EINTR)
+                ;
+
+        struct job_result r = { .slot = i, .job = h.job, .status = status,
+                                .elapsed_ms = now_ms() - t0 };
+        if (write(RESULT_FD, &r, sizeof(r)) != sizeof(r))
             exit(1);
+        free(cmd);
+    }
+    exit(0);
+}
+
+// expand every "{}" in the --each template to one line of the job list,
+// single-quoted so the shell sees it as one word whatever it contains
+static char *expand_template(const char *tmpl, const char *arg) {
+    size_t count = 0;
+    for (const char *p = tmpl; (p = strstr(p, "{}")); p += 2)
+        count++;
+    // each ' becomes '\'' (4 bytes), plus the surrounding quotes
+    size_t alen = 2;
+    for (const char *a = arg; *a; a++)
+        alen += *a == '\'' ? 4 : 1;
+    char *out = malloc(strlen(tmpl) + count * alen + 1);
+    if (!out)
+        return NULL;
+
+    char *o = out;
+    const char *p = tmpl, *q;
+    while ((q = strstr(p, "{}"))) {
+        memcpy(o, p, (size_t)(q - p));
+        o += q - p;
+        *o++ = '\'';
+        for (const char *a = arg; *a; a++) {
+            if (*a == '\'') {
+                memcpy(o, "'\\''", 4);
+                o += 4;
+            } else {
+                *o++ = *a;
+            }
         }
+        *o++ = '\'';
+        p = q + 2;
+    }
+    strcpy(o, p);
+    return out;
+}
 
-        if (pid == 0) {
-            if (!quiet_mode)
-                printf("[Child %d] Started (PID=%d)\n", i, getpid());
+// read one job per line from path ("-" for stdin); blank lines and # comments are skipped
+int load_jobs(const char *path, const char *tmpl) {
+    FILE *f = strcmp(path, "-") ? fopen(path, "re") : stdin;
+    if (!f) {
+        perror("Error opening job list");
+        return -1;
+    }
 
-            // if random mode is enabled, children run at different speeds
-            int delay = random_mode ? (rand() % 3) + 1 : 1;
+    char *line = NULL;
+    size_t cap = 0;
+    int jcap = 0;
+    ssize_t len;
+    while ((len = getline(&line, &cap, f)) != -1) {
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+            line[--len] = '\0';
+        const char *p = line + strspn(line, " \t");
+        if (*p == '\0' || *p == '#')
+            continue;
 
-            // loops until parent kills child with SIGTERM
-            while (1) {
-                if (!quiet_mode)
-                    printf("[Child %d] Running...\n", i);
-                sleep(delay);
+        if (num_jobs == jcap) {
+            jcap = jcap ? jcap * 2 : 64;
+            struct job *nj = realloc(jobs, (size_t)jcap * sizeof(*nj));
+            if (!nj) {
+                perror("realloc");
+                return -1;
             }
-            exit(0);
-        } else {  
-            child_pids[i] = pid;  
+            jobs = nj;
+        }
+        struct job *j = &jobs[num_jobs];
+        memset(j, 0, sizeof(*j));
+        j->cmd = tmpl ? expand_template(tmpl, p) : strdup(p);
+        j->status = -1;
+        j->worker = -1;
+        if (!j->cmd) {
+            perror("malloc");
+            return -1;
+        }
+        num_jobs++;
+    }
+    free(line);
+    if (f != stdin)
+        fclose(f);
+
+    job_queue = malloc((size_t)(num_jobs ? num_jobs : 1) * sizeof(*job_queue));
+    if (!job_queue) {
+        perror("malloc");
+        return -1;
+    }
+    for (int k = 0; k < num_jobs; k++)
+        job_queue[k] = k;
+    queue_len = num_jobs;
+    return 0;
+}
+
+// a job is pending at most once, so the ring never holds more than num_jobs
+static void queue_push(int j, int front) {
+    if (front) {
+        queue_head = (queue_head + num_jobs - 1) % num_jobs;
+        job_queue[queue_head] = j;
+    } else {
+        job_queue[(queue_head + queue_len) % num_jobs] = j;
+    }
+    queue_len++;
+}
+
+static int queue_pop() {
+    int j = job_queue[queue_head];
+    queue_head = (queue_head + 1) % num_jobs;
+    queue_len--;
+    return j;
+}
+
+// once every job is done, closing the job pipes lets idle workers exit
+static void close_job_pipes() {
+    for (int i = 0; i < num_children; i++) {
+        if (children[i].job_fd >= 0) {
+            close(children[i].job_fd);
+            children[i].job_fd = -1;
         }
     }
 }
 
-// sends SIGTERM to kill each child one at a time
-void kill_children(int count) {
-    for (int i = 0; i < count; i++) {
-        if (child_pids[i] > 0) {
-            kill(child_pids[i], SIGTERM);
+// hand the next pending job to slot i if it is running and idle
+void dispatch_to(int i) {
+    struct child *c = &children[i];
+    if (c->pid <= 0 || c->job_fd < 0 || c->job >= 0 || queue_len == 0 || stopping)
+        return;
+
+    int j = queue_pop();
+    struct job_header h = { .job = j, .len = (uint32_t)strlen(jobs[j].cmd) };
+    struct iovec iov[2] = { { &h, sizeof(h) }, { jobs[j].cmd, h.len } };
+    if (writev(c->job_fd, iov, 2) != (ssize_t)(sizeof(h) + h.len)) {
+        // the worker is gone; the job waits for the next one and the exit is reaped as usual
+        queue_push(j, 1);
+        close(c->job_fd);
+        c->job_fd = -1;
+        return;
+    }
+    if (jobs_start == 0)
+        jobs_start = now_ms();
+    c->job = j;
+    c->job_sent = now_ms();
+}
+
+void dispatch_idle() {
+    for (int i = 0; i < num_children && queue_len > 0; i++)
+        dispatch_to(i);
+}
+
+// record one attempt of job j; failed jobs go back to the end of the queue
+void finish_job(int j, int status, double elapsed_ms, int slot) {
+    struct job *job = &jobs[j];
+    job->attempts++;
+    job->status = status;
+    job->elapsed_ms = elapsed_ms;
+    job->total_ms += elapsed_ms;
+    job->worker = slot;
+    jobs_end = now_ms();
+
+    if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+        job->done = 1;
+        jobs_done++;
+    } else if (job->attempts <= job_retries) {
+        printf("[processgroup] Job %d failed (attempt %d), retrying: %s\n", j, job->attempts, job->cmd);
+        queue_push(j, 0);
+    } else {
+        printf("[processgroup] Job %d failed after %d attempts: %s\n", j, job->attempts, job->cmd);
+        job->done = 1;
+        jobs_done++;
+    }
+
+    if (jobs_done == num_jobs)
+        close_job_pipes();
+}
+
+// drain the shared result pipe and give each reporting worker its next job
+void read_results() {
+    struct job_result r[64];
+    ssize_t n;
+
+    while ((n = read(result_rd, r, sizeof(r))) > 0) {
+        for (size_t k = 0; k < (size_t)n / sizeof(r[0]); k++) {
+            int i = r[k].slot;
+            if (i < 0 || i >= num_children || children[i].job != r[k].job)
+                continue;
+            children[i].job = -1;
+            finish_job(r[k].job, r[k].status, r[k].elapsed_ms, i);
+            dispatch_to(i);
+        }
+        dispatch_idle();    // picks up jobs requeued for retry
+    }
+}
+
+// posix_spawn()s the child for slot i and registers its pidfd with epoll.
+// children wait at a start gate until the parent has pinned them, set their
+// scheduling policy and attached their perf counters
+int use_gate() {
+    return placement != PLACE_NONE || use_batch || use_nice || perf_mode;
+}
+
+// glibc implements posix_spawn with clone(CLONE_VM | CLONE_VFORK), so the
+// parent's page tables are never copied, however large the child table grows.
+int spawn_child(int i) {
+    struct child *c = &children[i];
+
+    char slot[16];
+    snprintf(slot, sizeof(slot), "%d", i);
+    char *args[8];
+    int n = 0;
+    args[n++] = "processgroup";
+    args[n++] = "--child";
+    args[n++] = slot;
+    if (jobs)        args[n++] = "--worker";
+    if (use_gate())  args[n++] = "--gate";
+    if (quiet_mode)  args[n++] = "-q";
+    if (random_mode) args[n++] = "-r";
+    args[n] = NULL;
+
+    posix_spawnattr_t attr;
+    sigset_t empty, pipe_sig;
+    sigemptyset(&empty);
+    sigemptyset(&pipe_sig);
+    sigaddset(&pipe_sig, SIGPIPE);
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK |
+                                    POSIX_SPAWN_SETSIGDEF);
+    posix_spawnattr_setsigmask(&attr, &empty);
+    posix_spawnattr_setsigdefault(&attr, &pipe_sig);
+    posix_spawnattr_setpgroup(&attr, group_id);
+
+    // workers get their own job pipe on JOB_FD and the shared result pipe on
+    // RESULT_FD, and gated children a gate pipe on GATE_FD. Every source is
+    // above 4 because the signalfd and epoll fd already hold 3 and 4, and the
+    // gate comes last so it may replace whatever the parent has on 5.
+    posix_spawn_file_actions_t actions, *fa = NULL;
+    int job_pipe[2] = { -1, -1 };
+    int gate_pipe[2] = { -1, -1 };
+    if ((jobs && pipe2(job_pipe, O_CLOEXEC) == -1) ||
+        (use_gate() && pipe2(gate_pipe, O_CLOEXEC) == -1)) {
+        fprintf(stderr, "[processgroup] pipe for child %d: %s\n", i, strerror(errno));
+        if (job_pipe[0] >= 0) {
+            close(job_pipe[0]);
+            close(job_pipe[1]);
+        }
+        posix_spawnattr_destroy(&attr);
+        return -1;
+    }
+    if (jobs || gate_pipe[0] >= 0) {
+        posix_spawn_file_actions_init(&actions);
+        if (jobs) {
+            posix_spawn_file_actions_adddup2(&actions, job_pipe[0], JOB_FD);
+            posix_spawn_file_actions_adddup2(&actions, result_wr, RESULT_FD);
+        }
+        if (gate_pipe[0] >= 0)
+            posix_spawn_file_actions_adddup2(&actions, gate_pipe[0], GATE_FD);
+        fa = &actions;
+    }
+
+    pid_t pid;
+    int rc = posix_spawn(&pid, exe_path, fa, &attr, args, environ);
+    if (rc == EPERM && group_id != 0) {
+        // every member of the old group has exited: start a new group
+        posix_spawnattr_setpgroup(&attr, 0);
+        group_id = 0;
+        rc = posix_spawn(&pid, exe_path, fa, &attr, args, environ);
+    }
+    posix_spawnattr_destroy(&attr);
+    if (fa) {
+        posix_spawn_file_actions_destroy(fa);
+        for (int k = 0; k < 2; k++) {
+            if (job_pipe[k] >= 0 && (k == 0 || rc != 0))
+                close(job_pipe[k]);
+            if (gate_pipe[k] >= 0 && (k == 0 || rc != 0))
+                close(gate_pipe[k]);
         }
     }
+    if (rc != 0) {
+        fprintf(stderr, "[processgroup] spawn of child %d failed: %s\n", i, strerror(rc));
+        return -1;
+    }
+    if (group_id == 0)
+        group_id = pid;
+
+    c->pid = pid;
+    c->last_pid = pid;
+    c->started = now_ms();
+    c->restart_at = 0;
+    c->job_fd = job_pipe[1];
+    c->job = -1;
+    live_children++;
+
+    // the child runs none of its own code until it is past the gate
+    apply_placement(i);
+    if (perf_mode)
+        perf_attach(i);
+    if (gate_pipe[1] >= 0) {
+        if (write(gate_pipe[1], "g", 1) != 1)
+            fprintf(stderr, "[processgroup] gate for child %d: %s\n", i, strerror(errno));
+        close(gate_pipe[1]);
+    }
+    if (sample_interval_ms > 0)
+        sampler_attach(c);
+
+    // a pidfd becomes readable the moment the child exits
+    c->pidfd = pidfd_open(pid);
+    if (c->pidfd >= 0) {
+        struct epoll_event ev = { .events = EPOLLIN, .data.u32 = (uint32_t)i };
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, c->pidfd, &ev) == -1) {
+            perror("epoll_ctl");
+            close(c->pidfd);
+            c->pidfd = -1;
+        }
+    }
+    return 0;
 }
 
-// waits for all children to finish, preventing zombies
-void wait_for_children(int count) {
+// creates 'count' child processes; slots that fail to spawn are retried
+// with backoff (or left empty with --restart never) instead of aborting
+int spawn_children(int count) {
+    int failed = 0;
+    double start = now_ms();
+
     for (int i = 0; i < count; i++) {
-        if (child_pids[i] > 0) {
-            waitpid(child_pids[i], NULL, 0);
+        children[i].backoff_ms = backoff_min_ms;
+        if (spawn_child(i) == -1) {
+            failed++;
+            schedule_restart(i, 1);
+        }
+    }
+
+    double elapsed = now_ms() - start;
+    printf("[processgroup] Spawned %d of %d children in %.2f ms (%.1f us/child)\n",
+           count - failed, count, elapsed, count ? elapsed * 1000.0 / count : 0.0);
+    if (jobs)
+        dispatch_idle();
+    return count - failed;
+}
+
+// decide whether an exited child comes back, and when
+void schedule_restart(int i, int failed) {
+    struct child *c = &children[i];
+
+    if (restart_policy == RESTART_NEVER || (restart_policy == RESTART_ON_FAILURE && !failed))
+        return;
+    if (jobs && jobs_done == num_jobs)
+        return;     // nothing left for a new worker to do
+
+    double now = now_ms();
+    if (now - c->started >= BACKOFF_RESET_MS)
+        c->backoff_ms = backoff_min_ms;
+
+    c->restart_at = now + c->backoff_ms;
+    printf("[processgroup] Restarting child %d in %d ms\n", i, c->backoff_ms);
+
+    c->backoff_ms *= 2;
+    if (c->backoff_ms > backoff_max_ms)
+        c->backoff_ms = backoff_max_ms;
+}
+
+// reap slot i if its child has exited; returns 1 if it was reaped
+int reap_child(int i) {
+    struct child *c = &children[i];
+    int status;
+    struct rusage ru;
+
+    if (c->pid <= 0)
+        return 0;
+    // peek first: a zombie's /proc/<pid>/sched is readable until wait4() reaps it
+    siginfo_t si;
+    si.si_pid = 0;
+    if (waitid(P_PID, (id_t)c->pid, &si, WEXITED | WNOHANG | WNOWAIT) == -1 || si.si_pid == 0)
+        return 0;
+    long mig = read_migrations(c->pid);
+    if (wait4(c->pid, &status, WNOHANG, &ru) != c->pid)
+        return 0;
+    if (mig >= 0)
+        c->migrations = (c->migrations > 0 ? c->migrations : 0) + mig;
+    c->nvcsw += ru.ru_nvcsw;
+    c->nivcsw += ru.ru_nivcsw;
+    perf_collect(c);
+
+    if (jobs) {
+        // a result written just before exiting still counts
+        read_results();
+        if (c->job_fd >= 0) {
+            close(c->job_fd);
+            c->job_fd = -1;
+        }
+    }
+
+    if (c->pidfd >= 0) {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, c->pidfd, NULL);
+        close(c->pidfd);
+        c->pidfd = -1;
+    }
+    sampler_detach(c);
+
+    if (!stopping) {
+        if (WIFSIGNALED(status))
+            printf("[processgroup] Child %d (PID=%d) killed by signal %d\n", i, c->pid, WTERMSIG(status));
+        else
+            printf("[processgroup] Child %d (PID=%d) exited with status %d\n", i, c->pid, WEXITSTATUS(status));
+    }
+
+    c->pid = 0;
+    live_children--;
+    // an empty group's id can be reused by an unrelated process: never signal it again
+    if (live_children == 0)
+        group_id = 0;
+
+    // the job this worker died with is retried by whoever is idle
+    if (jobs && c->job >= 0) {
+        int j = c->job;
+        c->job = -1;
+        if (!stopping) {
+            finish_job(j, status, now_ms() - c->job_sent, i);
+            dispatch_idle();
         }
     }
+
+    if (!stopping)
+        schedule_restart(i, WIFSIGNALED(status) || WEXITSTATUS(status) != 0);
+    return 1;
+}
+
+// one SIGTERM to the whole process group; SIGKILL follows after kill_timeout_ms
+void kill_children() {
+    teardown_start = now_ms();
+    if (live_children == 0 || group_id <= 0)
+        return;
+    if (killpg(group_id, SIGTERM) == -1 && errno != ESRCH)
+        perror("killpg");
+    kill_deadline = teardown_start + kill_timeout_ms;
+}
+
+// children that ignored SIGTERM past the deadline get SIGKILL
+void escalate_kill() {
+    kill_deadline = 0;
+    if (live_children == 0 || group_id <= 0)
+        return;
+    printf("[processgroup] %d children still running after %d ms, sending SIGKILL\n",
+           live_children, kill_timeout_ms);
+    if (killpg(group_id, SIGKILL) == -1 && errno != ESRCH)
+        perror("killpg");
+}
+
+// record each live child's RSS while /proc can still be read
+void snapshot_children() {
+    double now = now_ms();
+    for (int i = 0; i < num_children; i++) {
+        struct child *c = &children[i];
+        if (c->pid <= 0)
+            continue;
+        if (sample_interval_ms > 0 && sample_child(i, now) == 0)
+            c->final_rss_kb = c->last.rss_kb;
+        else
+            c->final_rss_kb = read_vmrss(c->pid);
+    }
+}
+
+// drain the signalfd; SIGINT/SIGTERM start shutdown, SIGCHLD covers children without a pidfd
+void handle_signals() {
+    struct signalfd_siginfo si;
+
+    while (read(signal_fd, &si, sizeof(si)) == sizeof(si)) {
+        if (si.ssi_signo == SIGCHLD) {
+            for (int i = 0; i < num_children; i++)
+                if (children[i].pidfd < 0)
+                    reap_child(i);
+        } else if (!stopping) {
+            stopping = 1;
+            printf("\n[processgroup] %s caught — cleaning up...\n",
+                   si.ssi_signo == SIGINT ? "SIGINT" : "SIGTERM");
+            snapshot_children();
+            printf("[processgroup] Terminating children...\n");
+            kill_children();
+            printf("[processgroup] Waiting for children to exit...\n");
+        }
+    }
+}
+
+// milliseconds until the earliest pending restart (or the SIGKILL deadline
+// during shutdown), or -1 to sleep until an event
+int next_timeout() {
+    double next = 0;
+    if (stopping) {
+        next = kill_deadline;
+    } else {
+        for (int i = 0; i < num_children; i++)
+            if (children[i].restart_at > 0 && (next == 0 || children[i].restart_at < next))
+                next = children[i].restart_at;
+    }
+
+    if (next == 0)
+        return -1;
+    double wait = next - now_ms();
+    return wait <= 0 ? 0 : (int)wait + 1;
+}
+
+void start_due_restarts() {
+    double now = now_ms();
+    for (int i = 0; i < num_children; i++) {
+        struct child *c = &children[i];
+        if (c->restart_at > 0 && c->restart_at <= now) {
+            c->restarts++;
+            if (spawn_child(i) == -1)
+                schedule_restart(i, 1);     // try again after the next backoff step
+            else if (jobs)
+                dispatch_to(i);
+        }
+    }
+}
+
+// the parent's loop: sleeps in epoll_wait until a signal, a child exit or a restart is due
+void supervise() {
+    struct epoll_event events[MAX_EVENTS];
+
+    while (!stopping || live_children > 0) {
+        // job mode ends when the workers have exited and none is due to restart
+        if (jobs && !stopping && live_children == 0 &&
+            (jobs_done == num_jobs || next_timeout() == -1))
+            break;
+
+        int n = epoll_wait(epoll_fd, events, MAX_EVENTS, next_timeout());
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            perror("epoll_wait");
+            break;
+        }
+
+        // signals first, so a child killed during shutdown is not restarted
+        for (int e = 0; e < n; e++)
+            if (events[e].data.u32 == TOKEN_SIGNAL)
+                handle_signals();
+
+        for (int e = 0; e < n; e++) {
+            uint32_t token = events[e].data.u32;
+            if (token == TOKEN_TIMER)
+                sample_all();
+            else if (token == TOKEN_RESULTS)
+                read_results();
+            else if (token != TOKEN_SIGNAL)
+                reap_child((int)token);
+        }
+
+        if (!stopping)
+            start_due_restarts();
+        else if (kill_deadline > 0 && live_children > 0 && now_ms() >= kill_deadline)
+            escalate_kill();
+    }
+
+    if (stopping)
+        printf("[processgroup] Teardown of %d children took %.2f ms\n", num_children,
+               now_ms() - teardown_start);
+}
+
+// allow one pidfd (plus /proc fds when sampling) per child
+void raise_fd_limit() {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == -1)
+        return;
+    rlim_t per_child = 1 + (sample_interval_ms > 0 ? 3 : 0) + (perf_mode ? NUM_PERF + 1 : 0) + (jobs ? 1 : 0);
+    rlim_t need = (rlim_t)num_children * per_child + 64;
+    if (rl.rlim_cur >= need)
+        return;
+    rl.rlim_cur = rl.rlim_max == RLIM_INFINITY || rl.rlim_max > need ? need : rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+    if (rl.rlim_cur < need)
+        fprintf(stderr, "[processgroup] Warning: open file limit %lu is below the %lu needed; "
+                "some children fall back to SIGCHLD\n", (unsigned long)rl.rlim_cur,
+                (unsigned long)need);
 }
 
 // prints directions for user testing
@@ -133,6 +1611,27 @@ void print_usage() {
     printf("  -n <num>     Number of children (1-%d)\n", MAX_CHILDREN);
     printf("  -q           Quiet mode (children do not print)\n");
     printf("  -r           Random delay for children\n");
+    printf("  --restart <never|on-failure|always>\n");
+    printf("               When to restart an exited child (default on-failure)\n");
+    printf("  --backoff <min>:<max>\n");
+    printf("               Restart delay in ms, doubling per crash (default 100:5000)\n");
+    printf("  --sample <ms>\n");
+    printf("               Sample each child's /proc stats every ms (>= %d)\n", MIN_SAMPLE_MS);
+    printf("  --csv <file> Write the samples as CSV\n");
+    printf("  --ring <n>   Samples kept per child for the summary (default 1024)\n");
+    printf("  --placement <compact|spread|numa>\n");
+    printf("               Pin children to CPUs using /sys/devices/system/cpu topology\n");
+    printf("  --cpus <list>\n");
+    printf("               Pin children round-robin to an explicit list, e.g. 0,2,4-7\n");
+    printf("  --nice <n>   Run children at nice value n\n");
+    printf("  --batch      Run children under SCHED_BATCH\n");
+    printf("  --perf       Count cycles, instructions, cache/branch misses and page faults per child\n");
+    printf("  --jobs <file> Run each line of file (- for stdin) as a job on a worker pool\n");
+    printf("  --each <cmd> With --jobs, each line is a file name substituted for {} in cmd\n");
+    printf("  --retries <n> Extra attempts for a failed job (default 1)\n");
+    printf("  --kill-timeout <ms>\n");
+    printf("               Grace period before SIGKILL at shutdown (default %d)\n",
+           DEFAULT_KILL_TIMEOUT_MS);
     printf("  --test       Run built-in test cases\n");
 }
 
@@ -146,19 +1645,57 @@ void run_test_cases() {
     printf("TEST 4: -q quiet mode suppresses child prints\n");
     printf("TEST 5: -r randomizes child timing\n");
     printf("TEST 6: Ctrl+C results in clean shutdown\n");
-    printf("TEST 7: Stress test with -n 20\n");
+    printf("TEST 7: Stress test with -n 2000 -q (spawn and teardown times are printed)\n");
+    printf("TEST 8: kill -SEGV <child> is reported and the child restarts after the backoff\n");
+    printf("TEST 9: --restart never leaves a killed child's slot empty\n");
+    printf("TEST 10: Parent shows 0%% CPU in top while idle\n");
+    printf("TEST 11: --sample 10 --csv out.csv records RSS/CPU rows for every child\n");
+    printf("TEST 12: Per-child memory is reported for every child at shutdown\n");
+    printf("TEST 13: ps -o pid,pgid shows all children in one group, separate from the parent\n");
+    printf("TEST 14: A child that ignores SIGTERM is killed after --kill-timeout\n");
+    printf("TEST 15: --placement spread pins child i to a different core; taskset -p <pid> confirms\n");
+    printf("TEST 16: --cpus 0 pins every child to CPU 0; Invol CS rises vs. no placement\n");
+    printf("TEST 17: --jobs with uneven sleeps: makespan is near total/N, utilization near 100%%\n");
+    printf("TEST 18: A job that exits non-zero is retried --retries times, then reported failed\n");
+    printf("TEST 19: kill -9 <worker> mid-job: the job is re-run by another worker\n");
+    printf("TEST 20: --perf prints per-child IPC and miss rates next to the rusage totals\n");
+    printf("TEST 21: --perf with perf_event_paranoid=3 or no PMU falls back to software events\n");
 }
 
 // main program
 int main(int argc, char *argv[]) {
 
     srand(time(NULL)); // Seed for random mode
+    const char *cpu_list = NULL;
+    const char *jobs_path = NULL, *job_template = NULL;
+    int n_given = 0;
+
+    // re-exec'd child: "processgroup --child <slot> [--worker] [--gate] [-q] [-r]"
+    if (argc >= 3 && !strcmp(argv[1], "--child")) {
+        int worker = 0;
+        for (int i = 3; i < argc; i++) {
+            if (!strcmp(argv[i], "-q")) quiet_mode = 1;
+            if (!strcmp(argv[i], "-r")) random_mode = 1;
+            if (!strcmp(argv[i], "--worker")) worker = 1;
+            if (!strcmp(argv[i], "--gate")) {
+                // wait for placement and perf counters; EOF means the parent gave up
+                char go;
+                while (read(GATE_FD, &go, 1) == -1 && errno == EINTR)
+                    ;
+                close(GATE_FD);
+            }
+        }
+        if (worker)
+            worker_main(atoi(argv[2]));
+        child_main(atoi(argv[2]));
+    }
 
     // command-line arguments :)
     for (int i = 1; i < argc; i++) {
 
         if (!strcmp(argv[i], "-n") && i + 1 < argc) {
             num_children = atoi(argv[++i]);
+            n_given = 1;
             if (num_children <= 0 || num_children > MAX_CHILDREN) {
                 fprintf(stderr, "Error: -n value must be between 1 and %d\n", MAX_CHILDREN);
                 return 1;
@@ -170,6 +1707,95 @@ int main(int argc, char *argv[]) {
         else if (!strcmp(argv[i], "-r")) {
             random_mode = 1;
         }
+        else if (!strcmp(argv[i], "--restart") && i + 1 < argc) {
+            const char *p = argv[++i];
+            if (!strcmp(p, "never"))
+                restart_policy = RESTART_NEVER;
+            else if (!strcmp(p, "on-failure"))
+                restart_policy = RESTART_ON_FAILURE;
+            else if (!strcmp(p, "always"))
+                restart_policy = RESTART_ALWAYS;
+            else {
+                fprintf(stderr, "Error: --restart must be never, on-failure or always\n");
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "--backoff") && i + 1 < argc) {
+            if (sscanf(argv[++i], "%d:%d", &backoff_min_ms, &backoff_max_ms) != 2 ||
+                backoff_min_ms <= 0 || backoff_max_ms < backoff_min_ms) {
+                fprintf(stderr, "Error: --backoff expects <min>:<max> in ms with 0 < min <= max\n");
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "--sample") && i + 1 < argc) {
+            sample_interval_ms = atoi(argv[++i]);
+            if (sample_interval_ms < MIN_SAMPLE_MS) {
+                fprintf(stderr, "Error: --sample interval must be at least %d ms\n", MIN_SAMPLE_MS);
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "--csv") && i + 1 < argc) {
+            csv_path = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--ring") && i + 1 < argc) {
+            int n = atoi(argv[++i]);
+            if (n <= 0) {
+                fprintf(stderr, "Error: --ring must be positive\n");
+                return 1;
+            }
+            ring_size = (size_t)n;
+        }
+        else if (!strcmp(argv[i], "--placement") && i + 1 < argc) {
+            const char *p = argv[++i];
+            if (!strcmp(p, "compact"))
+                placement = PLACE_COMPACT;
+            else if (!strcmp(p, "spread"))
+                placement = PLACE_SPREAD;
+            else if (!strcmp(p, "numa"))
+                placement = PLACE_NUMA;
+            else {
+                fprintf(stderr, "Error: --placement must be compact, spread or numa\n");
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "--cpus") && i + 1 < argc) {
+            placement = PLACE_LIST;
+            cpu_list = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--nice") && i + 1 < argc) {
+            child_nice = atoi(argv[++i]);
+            use_nice = 1;
+            if (child_nice < -20 || child_nice > 19) {
+                fprintf(stderr, "Error: --nice must be between -20 and 19\n");
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "--batch")) {
+            use_batch = 1;
+        }
+        else if (!strcmp(argv[i], "--perf")) {
+            perf_mode = 1;
+        }
+        else if (!strcmp(argv[i], "--jobs") && i + 1 < argc) {
+            jobs_path = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--each") && i + 1 < argc) {
+            job_template = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--retries") && i + 1 < argc) {
+            job_retries = atoi(argv[++i]);
+            if (job_retries < 0) {
+                fprintf(stderr, "Error: --retries must not be negative\n");
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "--kill-timeout") && i + 1 < argc) {
+            kill_timeout_ms = atoi(argv[++i]);
+            if (kill_timeout_ms < 0) {
+                fprintf(stderr, "Error: --kill-timeout must not be negative\n");
+                return 1;
+            }
+        }
         else if (!strcmp(argv[i], "--test")) {
             run_test_cases();
             return 0;
@@ -180,38 +1806,162 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    if (job_template && !jobs_path) {
+        fprintf(stderr, "Error: --each needs --jobs <file>\n");
+        return 1;
+    }
+    if (jobs_path) {
+        if (load_jobs(jobs_path, job_template) == -1)
+            return 1;
+        if (num_jobs == 0) {
+            fprintf(stderr, "Error: no jobs in %s\n", jobs_path);
+            return 1;
+        }
+        // one worker per online CPU unless -n says otherwise, never more than jobs
+        if (!n_given) {
+            long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+            num_children = ncpu > 0 && ncpu < MAX_CHILDREN ? (int)ncpu : 1;
+        }
+        if (num_children > num_jobs)
+            num_children = num_jobs;
+    }
+
     // Startup message
     printf("[processgroup] Starting with %d child processes.\n", num_children);
+    if (jobs)        printf("[processgroup] Job queue: %d jobs, %d retries each.\n", num_jobs, job_retries);
     if (quiet_mode)  printf("[processgroup] Quiet mode enabled.\n");
     if (random_mode) printf("[processgroup] Random mode enabled.\n");
+    if (placement != PLACE_NONE) printf("[processgroup] Placement: %s.\n", placement_names[placement]);
 
-    // install handler for ctrl+c
-    signal(SIGINT, sigint_handler);
+    // signals are read from a signalfd instead of interrupting us
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGCHLD);
+    if (sigprocmask(SIG_BLOCK, &mask, NULL) == -1) {
+        perror("sigprocmask");
+        return 1;
+    }
 
-    // creates children
-    spawn_children(num_children);
+    signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (signal_fd == -1 || epoll_fd == -1) {
+        perror("signalfd/epoll_create1");
+        return 1;
+    }
+    struct epoll_event ev = { .events = EPOLLIN, .data.u32 = TOKEN_SIGNAL };
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, signal_fd, &ev) == -1) {
+        perror("epoll_ctl");
+        return 1;
+    }
 
-    // parent sleeps until SIGINT is received
-    while (!stop_flag) {
-        sleep(1);
+    if (jobs) {
+        // results from every worker arrive on one pipe; a worker that dies
+        // must not take the parent down with SIGPIPE on its job pipe
+        int fds[2];
+        if (pipe2(fds, O_CLOEXEC) == -1) {
+            perror("pipe2");
+            return 1;
+        }
+        result_rd = fds[0];
+        result_wr = fds[1];
+        fcntl(result_rd, F_SETFL, O_NONBLOCK);
+        struct epoll_event rev = { .events = EPOLLIN, .data.u32 = TOKEN_RESULTS };
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, result_rd, &rev) == -1) {
+            perror("epoll_ctl");
+            return 1;
+        }
+        signal(SIGPIPE, SIG_IGN);
     }
 
-    // cleanup phase
-    printf("[processgroup] Terminating children...\n");
-    kill_children(num_children);
+    if (csv_path && sample_interval_ms == 0) {
+        fprintf(stderr, "Error: --csv needs --sample <ms>\n");
+        return 1;
+    }
 
-    printf("[processgroup] Waiting for children to exit...\n");
-    wait_for_children(num_children);
+    ssize_t len = readlink("/proc/self/exe", exe_path, sizeof(exe_path) - 1);
+    if (len <= 0) {
+        perror("readlink /proc/self/exe");
+        return 1;
+    }
+    exe_path[len] = '\0';
+
+    children = calloc((size_t)num_children, sizeof(*children));
+    if (!children) {
+        perror("calloc");
+        return 1;
+    }
+    raise_fd_limit();
+    if (setup_placement(cpu_list) == -1)
+        return 1;
+
+    // creates children
+    for (int i = 0; i < num_children; i++) {
+        children[i].pidfd = -1;
+        children[i].stat_fd = children[i].statm_fd = children[i].status_fd = -1;
+        children[i].final_rss_kb = -1;
+        children[i].migrations = -1;
+        children[i].cpu = children[i].node = -1;
+        children[i].job_fd = -1;
+        children[i].job = -1;
+        for (int k = 0; k < NUM_PERF; k++)
+            children[i].perf_fd[k] = -1;
+    }
+    start_ms = now_ms();
+    if (sample_interval_ms > 0 && sampler_start() == -1)
+        return 1;
+    if (spawn_children(num_children) == 0 && restart_policy == RESTART_NEVER) {
+        fprintf(stderr, "Error: no children could be started\n");
+        return 1;
+    }
+
+    // sleep in epoll_wait until SIGINT/SIGTERM (or the job queue drains);
+    // crashed children are restarted
+    supervise();
+
+    int rc = 0;
+    if (jobs && print_job_report() > 0)
+        rc = 1;
 
     // print resource usage
     print_total_resource_usage();
 
-    printf("Per-Child Memory Usage\n");
-    for (int i = 0; i < num_children; i++) {
-        print_child_memory(child_pids[i]);
+    if (perf_mode)
+        print_perf_report();
+
+    if (placement != PLACE_NONE || use_batch || use_nice)
+        print_placement_report();
+
+    if (sample_interval_ms > 0)
+        print_sampler_summary();
+
+    // workers exit on their own once the queue drains, before any RSS is read
+    if (!jobs) {
+        printf("Per-Child Memory Usage\n");
+        for (int i = 0; i < num_children; i++) {
+            print_child_memory(i);
+        }
     }
 
+    if (csv_file && fclose(csv_file) != 0)
+        perror("Error writing CSV file");
+    for (int i = 0; i < num_children; i++)
+        free(children[i].ring);
+    free(children);
+    free(cpus);
+    for (int j = 0; j < num_jobs; j++)
+        free(jobs[j].cmd);
+    free(jobs);
+    free(job_queue);
+    if (result_rd >= 0) {
+        close(result_rd);
+        close(result_wr);
+    }
+    if (timer_fd >= 0)
+        close(timer_fd);
+    close(signal_fd);
+    close(epoll_fd);
     printf("\n[processgroup] All cleaned up. Exiting.\n");
-    return 0;
+    return rc;
 }
-
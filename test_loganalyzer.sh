@@ -0,0 +1,164 @@
+#!/bin/bash
+#
+# Regression tests for loganalyzer. Build both tools first:
+#   gcc -O2 -pthread loganalyzer.c mappedfile.c -o loganalyzer
+#   gcc -O2 logbench.c -o logbench -lm
+# Every answer is checked against an independent full scan with awk; the
+# exit status is the number of failed tests.
+
+export LC_ALL=C
+TMP=$(mktemp -d) || exit 1
+trap 'rm -rf "$TMP"' EXIT
+FAILED=0
+
+check() {
+    if [ "$2" = "$3" ]; then
+        echo "✓ $1"
+    else
+        echo "✗ $1"
+        echo "  expected: $2"
+        echo "  got:      $3"
+        FAILED=$((FAILED + 1))
+    fi
+}
+
+# the level loganalyzer gives a line: a leading keyword (after blanks and
+# '['), else any keyword in the line, most severe first
+AWK_LEVEL='
+function level(s,   t) {
+    t = s
+    sub(/^[ \t[]+/, "", t)
+    if (t ~ /^ERROR/) return "ERROR"
+    if (t ~ /^WARNING/) return "WARNING"
+    if (t ~ /^INFO/) return "INFO"
+    if (index(s, "ERROR")) return "ERROR"
+    if (index(s, "WARNING")) return "WARNING"
+    if (index(s, "INFO")) return "INFO"
+    return "OTHER"
+}'
+
+echo "=== TEST CASES FOR loganalyzer ==="
+
+# a generated log spanning many index blocks, plus lines that exercise the
+# classifier and a last line without a newline
+LOG="$TMP/index.log"
+./logbench gen -o "$LOG" -s 4M -d skewed > /dev/null || exit 2
+printf '[ERROR] bracketed\n  WARNING: indented\nno level here\nINFO then ERROR later\nERROR last line' >> "$LOG"
+
+# Test 1: build the index
+echo -e "\n[TEST 1] --build-index"
+./loganalyzer --build-index "$LOG" > /dev/null
+check "index built" 0 $?
+
+# Test 2: per-level totals
+echo -e "\n[TEST 2] --count vs. full scan"
+expected=$(awk "$AWK_LEVEL"'
+    { n[level($0)]++ }
+    END {
+        printf "Indexed lines: %d\nERROR lines: %d\nWARNING lines: %d\nINFO lines: %d\nOther lines: %d\n",
+               NR, n["ERROR"], n["WARNING"], n["INFO"], n["OTHER"]
+    }' "$LOG")
+check "--count" "$expected" "$(./loganalyzer --count "$LOG")"
+
+# Test 3: line ranges, inside one block and across block boundaries
+echo -e "\n[TEST 3] --lines vs. full scan"
+for range in 1:1 3:10 1000:2000 4090:4110 1:100000 40000:99999; do
+    a=${range%:*} b=${range#*:}
+    expected=$(awk -v a="$a" -v b="$b" "$AWK_LEVEL"'
+        NR >= a && NR <= b { n[level($0)]++ }
+        END {
+            printf "Lines %d-%d: ERROR=%d WARNING=%d INFO=%d OTHER=%d\n",
+                   a, b, n["ERROR"], n["WARNING"], n["INFO"], n["OTHER"]
+        }' "$LOG")
+    check "--lines $range" "$expected" "$(./loganalyzer --lines "$range" "$LOG" 2>&1)"
+done
+
+# Test 4: byte ranges count the lines that start inside them
+echo -e "\n[TEST 4] --bytes vs. full scan"
+for range in 0:1 100:900 65536:1048576 1000000:4000000; do
+    a=${range%:*} b=${range#*:}
+    expected=$(awk -v a="$a" -v b="$b" "$AWK_LEVEL"'
+        { if (off >= a && off < b) { n[level($0)]++; lines++ } off += length($0) + 1 }
+        END {
+            printf "Bytes %d-%d (%d lines): ERROR=%d WARNING=%d INFO=%d OTHER=%d\n",
+                   a, b, lines, n["ERROR"], n["WARNING"], n["INFO"], n["OTHER"]
+        }' "$LOG")
+    check "--bytes $range" "$expected" "$(./loganalyzer --bytes "$range" "$LOG" 2>&1)"
+done
+
+# Test 5: the Nth line of a level, including the unterminated last line
+echo -e "\n[TEST 5] --nth vs. full scan"
+for q in ERROR:1 ERROR:100 WARNING:2500 INFO:7 ERROR:last; do
+    lvl=${q%:*} n=${q#*:}
+    [ "$n" = last ] && n=$(awk "$AWK_LEVEL"' level($0) == "ERROR" { c++ } END { print c }' "$LOG")
+    expected=$(awk -v l="$lvl" -v n="$n" "$AWK_LEVEL"'
+        level($0) == l && ++c == n { printf "%s #%d at line %d: %s\n", l, n, NR, $0; exit }' "$LOG")
+    check "--nth $lvl:$n" "$expected" "$(./loganalyzer --nth "$lvl:$n" "$LOG" 2>&1)"
+done
+
+# Test 6: a changed log makes the index stale until it is rebuilt
+echo -e "\n[TEST 6] Stale index"
+touch -d '+1 minute' "$LOG"
+out=$(./loganalyzer --count "$LOG" 2>&1)
+status=$?
+check "touch: exit status 2" 2 "$status"
+check "touch: reported stale" 1 "$(grep -c stale <<< "$out")"
+./loganalyzer --build-index "$LOG" > /dev/null
+check "rebuilt index accepted" 0 "$(./loganalyzer --count "$LOG" > /dev/null 2>&1; echo $?)"
+echo "INFO appended" >> "$LOG"
+./loganalyzer --count "$LOG" > /dev/null 2>&1
+check "append: exit status 2" 2 $?
+
+# Test 7: a header (96 bytes) or block whose counts disagree with the rest
+# of the index is rejected instead of sending queries past the mapping
+echo -e "\n[TEST 7] Corrupt index"
+./loganalyzer --build-index "$LOG" > /dev/null
+cp "$LOG.idx" "$TMP/good.idx"
+printf '\x00\xca\x9a\x3b' | dd of="$LOG.idx" bs=1 seek=40 conv=notrunc 2> /dev/null
+./loganalyzer --lines 1:900000000 "$LOG" > /dev/null 2>&1
+check "total_lines = 10^9: exit status 2" 2 $?
+cp "$TMP/good.idx" "$LOG.idx"
+printf '\xff\xff' | dd of="$LOG.idx" bs=1 seek=$((96 + 8)) conv=notrunc 2> /dev/null
+./loganalyzer --count "$LOG" > /dev/null 2>&1
+check "block line count: exit status 2" 2 $?
+
+# Test 8: a log over 2 x CHUNK_SIZE is split into chunks; every way of
+# scanning it must agree, and with a byte-level full scan
+echo -e "\n[TEST 8] Chunked scan of an 80 MB log"
+GEN="$TMP/gen.log" BIG="$TMP/big.log"
+./logbench gen -o "$GEN" -s 80M -d skewed > /dev/null || exit 2
+# splice keywords across the first chunk boundary at 32 MiB (also a pipe
+# block boundary) and the first mapping window boundary at 64 MiB
+A=$((32 << 20)) B=$((64 << 20))
+{
+    head -c $((A - 3)) "$GEN"
+    printf ' ERROR'
+    tail -c +$((A - 2)) "$GEN" | head -c $((B - A - 7))
+    printf 'WARNING '
+    tail -c +$((B - 9)) "$GEN"
+    echo                    # the generated log may stop mid-line
+} > "$BIG"
+expected=$(awk '
+    { lines++; chars += length($0) + 1; words += NF
+      e += gsub(/ERROR/, ""); w += gsub(/WARNING/, ""); i += gsub(/INFO/, "") }
+    END { printf "Summary: %d lines, %d words, %d chars, %d ERR, %d WARN, %d INFO\n",
+                 lines, words, chars, e, w, i }' "$BIG")
+check "-s -j 1" "$expected" "$(./loganalyzer -s -j 1 "$BIG" 2> /dev/null)"
+check "-s -j $(nproc)" "$expected" "$(./loganalyzer -s -j "$(nproc)" "$BIG" 2> /dev/null)"
+check "-s -j 7" "$expected" "$(./loganalyzer -s -j 7 "$BIG" 2> /dev/null)"
+check "-s - (redirected file)" "$expected" "$(./loganalyzer -s - < "$BIG" 2> /dev/null)"
+check "-s - (pipe)" "$expected" "$(cat "$BIG" | ./loganalyzer -s - 2> /dev/null)"
+check "throughput on stderr" 1 "$(./loganalyzer -s "$BIG" 2>&1 > /dev/null | grep -c 'GB/s')"
+
+# Test 9: a glob that matches nothing fails the run like a missing file,
+# while the other operands are still reported
+echo -e "\n[TEST 9] Unmatched glob"
+out=$(./loganalyzer -s "$LOG" "$TMP/nomatch*.log" 2> /dev/null)
+status=$?
+check "unmatched glob: exit status 2" 2 "$status"
+check "other operand still scanned" 1 "$(grep -c Summary <<< "$out")"
+./loganalyzer -s "$TMP/nomatch.log" > /dev/null 2>&1
+check "missing file: exit status 2" 2 $?
+
+echo -e "\n=== END OF TEST CASES: $FAILED failed ==="
+exit $FAILED